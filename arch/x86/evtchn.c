@@ -0,0 +1,99 @@
+/**
+ * @file arch/x86/evtchn.c
+ *
+ * %x86 specific bits of event channel handling.
+ */
+#include <xtf/atomic.h>
+#include <xtf/evtchn.h>
+#include <xtf/lib.h>
+#include <xtf/traps.h>
+
+#include <arch/idt.h>
+#include <arch/segment.h>
+
+void entry_EVTCHN(void);
+
+int arch_init_evtchn(void)
+{
+    if ( IS_DEFINED(CONFIG_HVM) )
+    {
+        const struct xtf_idte idte = {
+            .addr = _u(entry_EVTCHN),
+            .cs = __KERN_CS,
+        };
+        int rc;
+
+        xtf_set_idte(X86_VEC_EVTCHN, &idte);
+
+        rc = hvm_set_param(HVM_PARAM_CALLBACK_IRQ,
+                           ((uint64_t)HVM_PARAM_CALLBACK_TYPE_VECTOR <<
+                            HVM_PARAM_CALLBACK_TYPE_SHIFT) | X86_VEC_EVTCHN);
+        if ( rc )
+        {
+            printk("%s() Failed to set callback vector: %d\n", __func__, rc);
+            return rc;
+        }
+    }
+
+    /* PV guests register entry_EVTCHN as their event callback at boot. */
+
+    return 0;
+}
+
+void evtchn_enable_upcalls(void)
+{
+    struct vcpu_info *vcpu = &shared_info.vcpu_info[0];
+
+    ACCESS_ONCE(vcpu->evtchn_upcall_mask) = 0;
+    barrier();
+
+    if ( IS_DEFINED(CONFIG_HVM) )
+        asm volatile ("sti" ::: "memory");
+
+    else if ( ACCESS_ONCE(vcpu->evtchn_upcall_pending) )
+        /* Xen delivers pending upcalls on the way out of any hypercall. */
+        hypercall_xen_version(XENVER_version, NULL);
+}
+
+bool evtchn_disable_upcalls(void)
+{
+    /*
+     * HVM upcalls are gated by EFLAGS.IF alone.  Leave the mask untouched:
+     * nothing clears it on the way out of an upcall, so a disable/enable
+     * pair within a handler would leave it stale.
+     */
+    if ( IS_DEFINED(CONFIG_HVM) )
+    {
+        bool was_enabled = read_flags() & X86_EFLAGS_IF;
+
+        asm volatile ("cli" ::: "memory");
+
+        return was_enabled;
+    }
+
+    return !xchg(&shared_info.vcpu_info[0].evtchn_upcall_mask, 1);
+}
+
+void evtchn_block(void)
+{
+    if ( IS_DEFINED(CONFIG_HVM) )
+    {
+        ACCESS_ONCE(shared_info.vcpu_info[0].evtchn_upcall_mask) = 0;
+
+        /* The STI shadow ensures the upcall can't be taken before HLT. */
+        asm volatile ("sti; hlt" ::: "memory");
+    }
+    else
+        /* Atomically unmasks upcalls, and blocks if none are pending. */
+        hypercall_sched_op(SCHEDOP_block, NULL);
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -10,20 +10,23 @@
 #include <arch/pagetable.h>
 #include <arch/symbolic-const.h>
 
-int arch_map_gnttab(void)
+int arch_map_gnttab(unsigned int start, unsigned int nr)
 {
-    unsigned int i;
+    unsigned int i = start, end = start + nr;
     int rc = 0;
 
     /* Ensure gnttab_raw[] is a whole number of pages. */
     BUILD_BUG_ON(sizeof(gnttab_raw) % PAGE_SIZE);
 
+    if ( end > sizeof(gnttab_raw) / PAGE_SIZE )
+        return -E2BIG;
+
     if ( IS_DEFINED(CONFIG_PV) )
     {
         unsigned long gnttab_gfns[sizeof(gnttab_raw) / PAGE_SIZE] = {};
         struct gnttab_setup_table setup = {
             .dom = DOMID_SELF,
-            .nr_frames = ARRAY_SIZE(gnttab_gfns),
+            .nr_frames = end, /* Grows the table if necessary. */
             .frame_list = gnttab_gfns,
         };
 
@@ -35,7 +38,7 @@ int arch_map_gnttab(void)
             return -EIO;
         }
 
-        for ( i = 0; !rc && i < ARRAY_SIZE(gnttab_gfns); ++i )
+        for ( ; !rc && i < end; ++i )
             rc = hypercall_update_va_mapping(
                 _u(&gnttab_raw[i * PAGE_SIZE]),
                 pte_from_gfn(gnttab_gfns[i], PF_SYM(AD, RW, P)), UVMF_INVLPG);
@@ -45,12 +48,12 @@ int arch_map_gnttab(void)
         struct xen_add_to_physmap xatp = {
             .domid = DOMID_SELF,
             .space = XENMAPSPACE_grant_table,
-            .idx = 0,
-            .gfn = virt_to_gfn(gnttab_raw),
+            .idx = start,
+            .gfn = virt_to_gfn(&gnttab_raw[start * PAGE_SIZE]),
         };
 
-        for ( i = 0; !rc && i < (sizeof(gnttab_raw) / PAGE_SIZE);
-              ++i, ++xatp.idx, ++xatp.gfn )
+        /* Xen grows the table when mapping a frame beyond its end. */
+        for ( ; !rc && i < end; ++i, ++xatp.idx, ++xatp.gfn )
             rc = hypercall_memory_op(XENMEM_add_to_physmap, &xatp);
     }
 
@@ -11,6 +11,7 @@
 #include <arch/hpet.h>
 
 unsigned int hpet_nr_timers;
+uint32_t hpet_period;
 
 union hpet_timer {
     uint32_t raw;
@@ -40,6 +41,8 @@ int hpet_init(void)
     if ( period == 0 || period > HPET_ID_MAX_PERIOD )
         return -ENODEV;
 
+    hpet_period = period;
+
     /* Get number of timers. */
     hpet_nr_timers = MASK_EXTR(id, HPET_ID_NUMBER_MASK) + 1;
 
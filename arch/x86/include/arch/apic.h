@@ -18,6 +18,8 @@
 /* Local APIC register definitions. */
 #define APIC_ID         0x020
 #define APIC_LVR        0x030
+#define APIC_TASKPRI    0x080
+#define APIC_EOI        0x0b0
 #define APIC_SPIV       0x0f0
 #define   APIC_SPIV_APIC_ENABLED  0x00100
 
@@ -28,6 +30,17 @@
 
 #define APIC_ICR2       0x310
 
+#define APIC_LVTT       0x320
+#define   APIC_LVT_MASKED         0x10000
+#define   APIC_TIMER_ONESHOT      0x00000
+#define   APIC_TIMER_PERIODIC     0x20000
+#define   APIC_TIMER_TSC_DEADLINE 0x40000
+
+#define APIC_TMICT      0x380
+#define APIC_TMCCT      0x390
+#define APIC_TDCR       0x3e0
+#define   APIC_TDR_DIV_1          0xb
+
 #define APIC_DEFAULT_BASE 0xfee00000ul
 
 /* Utilities. */
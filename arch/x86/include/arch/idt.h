@@ -19,6 +19,13 @@
  */
 #define X86_VEC_AVAIL    0x21
 
+/**
+ * Event channel upcalls, for HVM guests.
+ *
+ * PV guests receive upcalls via a registered callback instead.
+ */
+#define X86_VEC_EVTCHN   0x22
+
 
 #ifndef __ASSEMBLY__
 
@@ -24,7 +24,9 @@
 #define   IOAPIC_MAXREDIR_MASK    0xff0000
 
 #define IOAPIC_REDIR_ENTRY(e)     (0x10 + (e) * 2)
+#define   IOAPIC_REDIR_LEVEL      (1u << 15)
 #define   IOAPIC_REDIR_MASK_SHIFT 16
+#define   IOAPIC_REDIR_DEST_SHIFT 56
 
 #define IOAPIC_DEFAULT_BASE       0xfec00000
 
@@ -62,6 +64,13 @@ static inline void ioapic_write64(unsigned int reg, uint64_t val)
  */
 int ioapic_set_mask(unsigned int entry, bool mask);
 
+/**
+ * Route a redirection entry, unmasked, to @p vector on the local APIC with
+ * physical ID @p dest.  Fixed delivery, active high.
+ */
+int ioapic_set_redir(unsigned int entry, unsigned int vector,
+                     unsigned int dest, bool level);
+
 #endif /* !XTF_X86_IO_APIC_H */
 
 /*
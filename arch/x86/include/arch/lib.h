@@ -409,6 +409,28 @@ static inline void flush_tlb(void)
     write_cr3(read_cr3());
 }
 
+static inline uint64_t rdtsc(void)
+{
+    uint32_t lo, hi;
+
+    asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/*
+ * `rdtsc`, ordered against all earlier instructions.  Use when timing
+ * a region of code, so the timestamp isn't taken speculatively early.
+ */
+static inline uint64_t rdtsc_ordered(void)
+{
+    uint32_t lo, hi;
+
+    asm volatile ("lfence; rdtsc" : "=a" (lo), "=d" (hi) :: "memory");
+
+    return ((uint64_t)hi << 32) | lo;
+}
+
 #endif /* XTF_X86_LIB_H */
 
 /*
@@ -0,0 +1,73 @@
+/**
+ * @file arch/x86/include/arch/mmu-batch.h
+ *
+ * Batching of PV pagetable updates.
+ *
+ * `update_va_mapping` costs one guest/hypervisor transition per PTE.  A
+ * #mmu_batch accumulates PTE writes and issues them as a single
+ * `mmu_update`, followed by the requested TLB flush, in one hypercall.
+ */
+#ifndef XTF_X86_MMU_BATCH_H
+#define XTF_X86_MMU_BATCH_H
+
+#include <xtf/hypercall.h>
+
+#include <arch/page.h>
+
+/** Maximum number of updates a batch can hold before it is issued. */
+#define MMU_BATCH_MAX 512
+
+struct mmu_batch {
+    unsigned int nr;            /**< Number of pending updates.           */
+    unsigned int flags;         /**< UVMF_* flush to perform when issued. */
+    mmu_update_t reqs[MMU_BATCH_MAX];
+    mmuext_op_t  ops[MMU_BATCH_MAX];
+};
+
+/**
+ * Initialise a batch.
+ *
+ * @param b     The batch.
+ * @param flags UVMF_* flush type and scope, with the same meaning as for
+ *              `update_va_mapping`, applied to the batch as a whole.
+ */
+void mmu_batch_init(struct mmu_batch *b, unsigned int flags);
+
+/**
+ * Queue a PTE update.  The batch is issued automatically if it is full.
+ *
+ * @param b      The batch.
+ * @param l1e    Machine address of the PTE to update.  See #pv_l1e_maddr().
+ * @param linear Linear address mapped by the PTE, for `UVMF_INVLPG`.
+ * @param val    New PTE value.
+ * @returns 0 or -errno from issuing the batch.
+ */
+int mmu_batch_add(struct mmu_batch *b, uint64_t l1e,
+                  unsigned long linear, intpte_t val);
+
+/**
+ * Issue all pending updates, and perform the batch's TLB flush.
+ *
+ * @returns 0 or -errno.  The batch is empty afterwards, even on error.
+ */
+int mmu_batch_flush(struct mmu_batch *b);
+
+/**
+ * Find the machine address of the L1 PTE mapping @p linear, by walking the
+ * current pagetables.
+ *
+ * @returns the machine address, or 0 if @p linear isn't mapped with 4k pages.
+ */
+uint64_t pv_l1e_maddr(unsigned long linear);
+
+#endif /* XTF_X86_MMU_BATCH_H */
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
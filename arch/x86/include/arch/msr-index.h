@@ -8,6 +8,8 @@
 
 #include <xtf/numbers.h>
 
+#define MSR_TSC                         0x00000010
+
 #define MSR_APICBASE                    0x0000001b
 #define APICBASE_BSP                    (_AC(1, ULL) <<  8)
 #define APICBASE_EXTD                   (_AC(1, ULL) << 10)
@@ -15,6 +17,9 @@
 
 #define MSR_FEATURE_CONTROL             0x0000003a
 
+#define MSR_SPEC_CTRL                   0x00000048
+#define MSR_PRED_CMD                    0x00000049
+
 #define MSR_PMC(n)                     (0x000000c1 + (n))
 
 #define MSR_INTEL_PLATFORM_INFO         0x000000ce
@@ -23,7 +28,14 @@
 #define MSR_INTEL_MISC_FEATURES_ENABLES 0x00000140
 #define MISC_FEATURES_CPUID_FAULTING    (_AC(1, ULL) <<  0)
 
+#define MSR_SYSENTER_CS                 0x00000174
+#define MSR_SYSENTER_ESP                0x00000175
+#define MSR_SYSENTER_EIP                0x00000176
+
 #define MSR_PERFEVTSEL(n)              (0x00000186 + (n))
+#define PERFEVTSEL_USR                  (_AC(1, ULL) << 16) /* Count in CPL > 0 */
+#define PERFEVTSEL_OS                   (_AC(1, ULL) << 17) /* Count in CPL 0 */
+#define PERFEVTSEL_EN                   (_AC(1, ULL) << 22) /* Enable */
 
 #define MSR_MISC_ENABLE                 0x000001a0
 
@@ -33,6 +45,8 @@
 #define DEBUGCTL_BTS                    (_AC(1, ULL) <<  7) /* Branch Trace Store */
 #define DEBUGCTL_BTINT                  (_AC(1, ULL) <<  8) /* Branch Trace Interrupt */
 
+#define MSR_PAT                         0x00000277
+
 #define MSR_FIXED_CTR(n)               (0x00000309 + (n))
 #define MSR_PERF_CAPABILITIES           0x00000345
 #define MSR_FIXED_CTR_CTRL              0x0000038d
@@ -41,9 +55,26 @@
 #define MSR_PERF_GLOBAL_OVF_CTRL        0x00000390
 
 #define MSR_VMX_BASIC                   0x00000480
+#define MSR_VMX_PINBASED_CTLS           0x00000481
+#define MSR_VMX_PROCBASED_CTLS          0x00000482
+#define MSR_VMX_EXIT_CTLS               0x00000483
+#define MSR_VMX_ENTRY_CTLS              0x00000484
+#define MSR_VMX_MISC                    0x00000485
+#define MSR_VMX_CR0_FIXED0              0x00000486
+#define MSR_VMX_CR0_FIXED1              0x00000487
+#define MSR_VMX_CR4_FIXED0              0x00000488
+#define MSR_VMX_CR4_FIXED1              0x00000489
+#define MSR_VMX_VMCS_ENUM               0x0000048a
+#define MSR_VMX_PROCBASED_CTLS2         0x0000048b
+#define MSR_VMX_TRUE_PINBASED_CTLS      0x0000048d
+#define MSR_VMX_TRUE_PROCBASED_CTLS     0x0000048e
+#define MSR_VMX_TRUE_EXIT_CTLS          0x0000048f
+#define MSR_VMX_TRUE_ENTRY_CTLS         0x00000490
 
 #define MSR_A_PMC(n)                   (0x000004c1 + (n))
 
+#define MSR_TSC_DEADLINE                0x000006e0
+
 #define MSR_X2APIC_REGS                 0x00000800
 
 #define MSR_EFER                        0xc0000080 /* Extended Feature Enable Register */
@@ -64,6 +95,18 @@
 #define MSR_FS_BASE                     0xc0000100
 #define MSR_GS_BASE                     0xc0000101
 #define MSR_SHADOW_GS_BASE              0xc0000102
+#define MSR_TSC_AUX                     0xc0000103
+
+#define MSR_K7_PERFCTL(n)              (0xc0010000 + (n))
+#define MSR_K7_PERFCTR(n)              (0xc0010004 + (n))
+
+#define MSR_VM_CR                       0xc0010114
+#define VM_CR_SVMDIS                    (_AC(1, ULL) <<  4) /* SVM Disabled */
+
+#define MSR_VM_HSAVE_PA                 0xc0010117
+
+#define MSR_F15H_PERFCTL(n)            (0xc0010200 + 2 * (n))
+#define MSR_F15H_PERFCTR(n)            (0xc0010201 + 2 * (n))
 
 #define MSR_DR0_ADDR_MASK               0xc0011027
 #define MSR_DR1_ADDR_MASK               0xc0011019
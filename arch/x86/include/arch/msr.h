@@ -80,6 +80,53 @@ static inline bool wrmsr_safe(uint32_t idx, uint64_t val)
     return idx != new_idx;
 }
 
+/**
+ * Wrapper around a forced emulation `rdmsr`, which safely catches @#GP[0].
+ * Only usable when #xtf_has_fep is true.
+ *
+ * @param idx MSR to read
+ * @param [out] val Value, if no fault occurred.
+ * @return boolean indicating whether the read faulted.
+ */
+static inline bool rdmsr_fep_safe(uint32_t idx, uint64_t *val)
+{
+    uint32_t lo, hi, new_idx;
+
+    asm volatile (_ASM_XEN_FEP "1: rdmsr; 2:"
+                  _ASM_EXTABLE_HANDLER(1b, 2b, %P[hnd])
+                  : "=a" (lo), "=d" (hi), "=c" (new_idx)
+                  : "c" (idx), [hnd] "p" (ex_rdmsr_safe));
+
+    bool fault = idx != new_idx;
+
+    if ( !fault )
+        *val = (((uint64_t)hi) << 32) | lo;
+
+    return fault;
+}
+
+/**
+ * Wrapper around a forced emulation `wrmsr`, which safely catches @#GP[0].
+ * Only usable when #xtf_has_fep is true.
+ *
+ * @param idx MSR to write
+ * @param val Value to write
+ * @return boolean indicating whether the write faulted.
+ */
+static inline bool wrmsr_fep_safe(uint32_t idx, uint64_t val)
+{
+    uint32_t new_idx;
+
+    asm volatile (_ASM_XEN_FEP "1: wrmsr; 2:"
+                  _ASM_EXTABLE_HANDLER(1b, 2b, %P[hnd])
+                  : "=c" (new_idx)
+                  : "c" (idx), "a" ((uint32_t)val),
+                    "d" ((uint32_t)(val >> 32)),
+                    [hnd] "p" (ex_wrmsr_safe));
+
+    return idx != new_idx;
+}
+
 /*
  * Types wrapping MSR content.
  */
@@ -0,0 +1,73 @@
+/**
+ * @file arch/x86/include/arch/pmu.h
+ *
+ * Helpers for the Performance Monitoring Unit, as virtualised by Xen's vPMU.
+ *
+ * Counters are programmed via the architectural (Intel) or legacy/core (AMD)
+ * event select MSRs, and read with `rdpmc` where possible.  vPMU is off by
+ * default in Xen (`vpmu=on` on the command line enables it), so tests must
+ * cope with pmu_init() failing.
+ */
+#ifndef XTF_X86_PMU_H
+#define XTF_X86_PMU_H
+
+#include <xtf/types.h>
+
+/** Events which pmu_enable() can count. */
+enum pmu_event {
+    PMU_CYCLES,         /**< Core cycles, unhalted. */
+    PMU_INSTRUCTIONS,   /**< Instructions retired. */
+    PMU_DTLB_MISSES,    /**< dTLB misses causing a pagewalk.  Model-specific. */
+    PMU_LLC_MISSES,     /**< Last level cache misses.  Intel only. */
+
+    PMU_NR_EVENTS,
+};
+
+#define PMU_EVENT(e) (1u << (e))
+
+/** Counter values, indexed by @ref pmu_event. */
+struct pmu_sample {
+    uint64_t ctr[PMU_NR_EVENTS];
+};
+
+/**
+ * Detect the PMU, and check that its counters count.
+ *
+ * @returns 0 on success, or -ENODEV if no usable PMU is available.
+ */
+int pmu_init(void);
+
+/**
+ * Program counters for the events in @p mask (a mask of PMU_EVENT()s),
+ * counting in all privilege levels.  Any previously enabled events are
+ * disabled first.
+ *
+ * @returns the subset of @p mask being counted, which is limited by the
+ * events the CPU supports and the number of counters.
+ */
+unsigned int pmu_enable(unsigned int mask);
+
+/** Stop all counters. */
+void pmu_disable(void);
+
+/** Read the current value of each enabled counter into @p s. */
+void pmu_read(struct pmu_sample *s);
+
+/** Count of event @p e between samples @p start and @p end. */
+uint64_t pmu_delta(const struct pmu_sample *start,
+                   const struct pmu_sample *end, enum pmu_event e);
+
+/** Human readable name of @p e. */
+const char *pmu_event_name(enum pmu_event e);
+
+#endif /* XTF_X86_PMU_H */
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,87 @@
+/**
+ * @file arch/x86/include/arch/svm.h
+ *
+ * Helpers for SVM.
+ */
+#ifndef XTF_X86_SVM_H
+#define XTF_X86_SVM_H
+
+#include <xtf/types.h>
+#include <xtf/compiler.h>
+
+#include <arch/x86-svm.h>
+
+/*
+ * SVM instruction wrappers.  All take the physical address of a VMCB, which
+ * XTF's identity mappings make the same as its virtual address.
+ */
+static inline void vmload(unsigned long paddr)
+{
+    asm volatile ("vmload" :: "a" (paddr) : "memory");
+}
+
+static inline void vmsave(unsigned long paddr)
+{
+    asm volatile ("vmsave" :: "a" (paddr) : "memory");
+}
+
+static inline void clgi(void)
+{
+    asm volatile ("clgi" ::: "memory");
+}
+
+static inline void stgi(void)
+{
+    asm volatile ("stgi" ::: "memory");
+}
+
+/**
+ * Enable SVM, using the page at @p hsave for the host state save area.
+ *
+ * @returns 0 on success, or -ENODEV if SVM isn't available or is disabled
+ * by firmware.
+ */
+int svm_enable(void *hsave);
+
+/** Disable SVM. */
+void svm_disable(void);
+
+/**
+ * Initialise @p vmcb for a minimal L2 guest.
+ *
+ * The guest shares the current paging mode, address space, segments,
+ * descriptor tables and MSRs, starts executing at @p entry with its stack
+ * pointer at @p stack, and runs with interrupts disabled.  Only the
+ * mandatory `vmrun` intercept and `vmmcall` are intercepted.  Callers may
+ * adjust the VMCB further before the first svm_enter().
+ */
+void svm_init_vmcb(struct vmcb *vmcb, void (*entry)(void), void *stack);
+
+/**
+ * Enable nested paging for @p vmcb, with an identity map of the first 1GB
+ * of guest physical address space.
+ *
+ * @returns 0 on success, or -EOPNOTSUPP if nested paging isn't available,
+ * or the environment's paging mode isn't supported.
+ */
+int svm_enable_npt(struct vmcb *vmcb);
+
+/**
+ * Run the guest in @p vmcb, returning at the next #VMEXIT with the exit code
+ * in @p vmcb.  The guest's GPRs, other than `%rax` and `%rsp`, are not
+ * preserved across exits.  FS, GS, TR, LDTR and the syscall MSRs are shared
+ * between host and guest, unless the caller uses `vmload`/`vmsave`.
+ */
+void svm_enter(struct vmcb *vmcb);
+
+#endif /* XTF_X86_SVM_H */
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -6,6 +6,10 @@
 #ifndef XTF_X86_VMX_H
 #define XTF_X86_VMX_H
 
+#include <xtf/types.h>
+#include <xtf/compiler.h>
+#include <xtf/macro_magic.h>
+
 #include <arch/x86-vmx.h>
 
 /**
@@ -13,6 +17,145 @@
  */
 const char *vmx_insn_err_strerror(unsigned int err);
 
+/*
+ * VMX instruction wrappers.  Those which can fail return true on VMsucceed,
+ * and false on VMfailInvalid or VMfailValid.  Physical addresses are
+ * identity mapped in HVM environments.
+ */
+static inline bool vmxon(uint64_t paddr)
+{
+    bool fail;
+
+    asm volatile ("vmxon %[paddr];"
+                  ASM_FLAG_OUT(, "setbe %[fail];")
+                  : ASM_FLAG_OUT("=@ccbe", [fail] "=qm") (fail)
+                  : [paddr] "m" (paddr)
+                  : "memory");
+
+    return !fail;
+}
+
+static inline void vmxoff(void)
+{
+    asm volatile ("vmxoff" ::: "memory");
+}
+
+static inline bool vmclear(uint64_t paddr)
+{
+    bool fail;
+
+    asm volatile ("vmclear %[paddr];"
+                  ASM_FLAG_OUT(, "setbe %[fail];")
+                  : ASM_FLAG_OUT("=@ccbe", [fail] "=qm") (fail)
+                  : [paddr] "m" (paddr)
+                  : "memory");
+
+    return !fail;
+}
+
+static inline bool vmptrld(uint64_t paddr)
+{
+    bool fail;
+
+    asm volatile ("vmptrld %[paddr];"
+                  ASM_FLAG_OUT(, "setbe %[fail];")
+                  : ASM_FLAG_OUT("=@ccbe", [fail] "=qm") (fail)
+                  : [paddr] "m" (paddr)
+                  : "memory");
+
+    return !fail;
+}
+
+static inline unsigned long vmread(unsigned long field)
+{
+    unsigned long val;
+
+    asm volatile ("vmread %[field], %[val]"
+                  : [val] "=rm" (val)
+                  : [field] "r" (field));
+
+    return val;
+}
+
+static inline bool vmwrite(unsigned long field, unsigned long val)
+{
+    bool fail;
+
+    asm volatile ("vmwrite %[val], %[field];"
+                  ASM_FLAG_OUT(, "setbe %[fail];")
+                  : ASM_FLAG_OUT("=@ccbe", [fail] "=qm") (fail)
+                  : [field] "r" (field), [val] "rm" (val));
+
+    return !fail;
+}
+
+/* Write a 64bit field, which takes two writes in 32bit mode. */
+static inline bool vmwrite64(unsigned long field, uint64_t val)
+{
+    if ( IS_DEFINED(CONFIG_64BIT) )
+        return vmwrite(field, val);
+
+    return vmwrite(field, val) && vmwrite(VMCS_HIGH(field), val >> 32);
+}
+
+/**
+ * Enter VMX operation, using the page at @p vmxon_region.  CR0 and CR4 are
+ * adjusted to meet VMX's fixed bit requirements.
+ *
+ * @returns 0 on success, -ENODEV if VT-x isn't available, or -EIO if
+ * `vmxon` fails.
+ */
+int vmx_enable(void *vmxon_region);
+
+/** Leave VMX operation. */
+void vmx_disable(void);
+
+/**
+ * Construct @p vmcs for a minimal L2 guest, and make it current.
+ *
+ * The guest shares the current paging mode, address space, segments and
+ * descriptor tables, starts executing at @p entry with its stack pointer at
+ * @p stack, and runs with all exceptions and interrupts delivered through
+ * its own IDT.  @p proc_ctls and @p proc_ctls2 request extra primary and
+ * secondary processor-based controls, on top of the minimum the capability
+ * MSRs require.
+ *
+ * Only paged environments are supported, as an unpaged guest requires
+ * "unrestricted guest".
+ *
+ * @returns 0 on success, -EOPNOTSUPP if a requested control or the paging
+ * mode isn't supported, or -EIO if a VMX instruction fails.
+ */
+int vmx_init_vmcs(void *vmcs, void (*entry)(void), void *stack,
+                  uint32_t proc_ctls, uint32_t proc_ctls2);
+
+/**
+ * Enter the guest in the current VMCS (`vmlaunch` the first time, `vmresume`
+ * subsequently), and return at the next VM exit.  The guest's GPRs are not
+ * preserved across exits.
+ *
+ * @returns true on VM exit, or false if the VM entry instruction failed.  A
+ * VM exit may still indicate a failed entry, via
+ * @ref VMX_EXIT_REASON_FAILED_ENTRY in the exit reason.
+ */
+bool vmx_enter(void);
+
+/**
+ * `vmclear` and reload @p vmcs, which must be current, so the next
+ * vmx_enter() uses `vmlaunch`.  The VMCS's contents are retained.
+ *
+ * @returns false if either instruction fails.
+ */
+bool vmx_relaunch(void *vmcs);
+
+/** Advance the guest past the instruction which caused the last exit. */
+void vmx_skip_insn(void);
+
+static inline uint32_t vmx_exit_reason(void)
+{
+    return vmread(VMCS_EXIT_REASON);
+}
+
 #endif /* XTF_X86_VMX_H */
 
 /*
@@ -0,0 +1,143 @@
+/**
+ * @file arch/x86/include/arch/x86-svm.h
+ *
+ * SVM hardware ABI, as specified in the AMD APM Vol2.
+ */
+#ifndef XTF_X86_X86_SVM_H
+#define XTF_X86_X86_SVM_H
+
+#include <xtf/types.h>
+
+/* CPUID 0x8000000a.edx SVM features. */
+#define SVM_FEATURE_NPT                 (1u <<  0)
+#define SVM_FEATURE_NRIPS               (1u <<  3)
+#define SVM_FEATURE_VMCB_CLEAN          (1u <<  5)
+
+/* VMCB intercept1 bits. */
+#define SVM_INTERCEPT1_CPUID            (1u << 18)
+#define SVM_INTERCEPT1_HLT              (1u << 24)
+
+/* VMCB intercept2 bits. */
+#define SVM_INTERCEPT2_VMRUN            (1u <<  0)
+#define SVM_INTERCEPT2_VMMCALL          (1u <<  1)
+#define SVM_INTERCEPT2_VMLOAD           (1u <<  2)
+#define SVM_INTERCEPT2_VMSAVE           (1u <<  3)
+
+/* VMCB clean bits. */
+#define VMCB_CLEAN_INTERCEPTS           (1u <<  0)
+#define VMCB_CLEAN_IOPM                 (1u <<  1)
+#define VMCB_CLEAN_ASID                 (1u <<  2)
+#define VMCB_CLEAN_TPR                  (1u <<  3)
+#define VMCB_CLEAN_NP                   (1u <<  4)
+#define VMCB_CLEAN_CRX                  (1u <<  5)
+#define VMCB_CLEAN_DRX                  (1u <<  6)
+#define VMCB_CLEAN_DT                   (1u <<  7)
+#define VMCB_CLEAN_SEG                  (1u <<  8)
+#define VMCB_CLEAN_CR2                  (1u <<  9)
+#define VMCB_CLEAN_LBR                  (1u << 10)
+#define VMCB_CLEAN_AVIC                 (1u << 11)
+#define VMCB_CLEAN_ALL                  0xfff
+
+/* VMCB np_ctrl bits. */
+#define VMCB_NP_ENABLE                  (1u <<  0)
+
+/* #VMEXIT codes. */
+#define VMEXIT_CPUID                    0x072
+#define VMEXIT_HLT                      0x078
+#define VMEXIT_VMRUN                    0x080
+#define VMEXIT_VMMCALL                  0x081
+#define VMEXIT_NPF                      0x400
+#define VMEXIT_INVALID                  (~0ull)
+
+/* A segment in the VMCB State Save Area. */
+struct vmcb_seg {
+    uint16_t sel;
+    uint16_t attr;  /* Descriptor bits 8-15 and 20-23, packed together. */
+    uint32_t limit;
+    uint64_t base;
+};
+
+/* Virtual Machine Control Block. */
+struct vmcb {
+    /* Control Area. */
+    uint32_t intercept_cr;              /* 0x000 */
+    uint32_t intercept_dr;              /* 0x004 */
+    uint32_t intercept_exceptions;      /* 0x008 */
+    uint32_t intercept1;                /* 0x00c */
+    uint32_t intercept2;                /* 0x010 */
+    uint8_t  _rsvd0[0x03c - 0x014];
+    uint16_t pause_filter_thresh;       /* 0x03c */
+    uint16_t pause_filter_count;        /* 0x03e */
+    uint64_t iopm_base_pa;              /* 0x040 */
+    uint64_t msrpm_base_pa;             /* 0x048 */
+    uint64_t tsc_offset;                /* 0x050 */
+    uint32_t asid;                      /* 0x058 */
+    uint8_t  tlb_control;               /* 0x05c */
+    uint8_t  _rsvd1[3];
+    uint64_t vintr;                     /* 0x060 */
+    uint64_t interrupt_shadow;          /* 0x068 */
+    uint64_t exitcode;                  /* 0x070 */
+    uint64_t exitinfo1;                 /* 0x078 */
+    uint64_t exitinfo2;                 /* 0x080 */
+    uint64_t exitintinfo;               /* 0x088 */
+    uint64_t np_ctrl;                   /* 0x090 */
+    uint8_t  _rsvd2[0x0a8 - 0x098];
+    uint64_t eventinj;                  /* 0x0a8 */
+    uint64_t n_cr3;                     /* 0x0b0 */
+    uint64_t virt_ext;                  /* 0x0b8 */
+    uint32_t clean;                     /* 0x0c0 */
+    uint32_t _rsvd3;
+    uint64_t nextrip;                   /* 0x0c8 */
+    uint8_t  _rsvd4[0x400 - 0x0d0];
+
+    /* State Save Area. */
+    struct vmcb_seg es, cs, ss, ds;     /* 0x400 */
+    struct vmcb_seg fs, gs;             /* 0x440 */
+    struct vmcb_seg gdtr, ldtr;         /* 0x460 */
+    struct vmcb_seg idtr, tr;           /* 0x480 */
+    uint8_t  _rsvd5[0x4cb - 0x4a0];
+    uint8_t  cpl;                       /* 0x4cb */
+    uint32_t _rsvd6;
+    uint64_t efer;                      /* 0x4d0 */
+    uint8_t  _rsvd7[0x548 - 0x4d8];
+    uint64_t cr4;                       /* 0x548 */
+    uint64_t cr3;                       /* 0x550 */
+    uint64_t cr0;                       /* 0x558 */
+    uint64_t dr7;                       /* 0x560 */
+    uint64_t dr6;                       /* 0x568 */
+    uint64_t rflags;                    /* 0x570 */
+    uint64_t rip;                       /* 0x578 */
+    uint8_t  _rsvd8[0x5d8 - 0x580];
+    uint64_t rsp;                       /* 0x5d8 */
+    uint8_t  _rsvd9[0x5f8 - 0x5e0];
+    uint64_t rax;                       /* 0x5f8 */
+    uint64_t star;                      /* 0x600 */
+    uint64_t lstar;                     /* 0x608 */
+    uint64_t cstar;                     /* 0x610 */
+    uint64_t sfmask;                    /* 0x618 */
+    uint64_t kernel_gs_base;            /* 0x620 */
+    uint64_t sysenter_cs;               /* 0x628 */
+    uint64_t sysenter_esp;              /* 0x630 */
+    uint64_t sysenter_eip;              /* 0x638 */
+    uint64_t cr2;                       /* 0x640 */
+    uint8_t  _rsvd10[0x668 - 0x648];
+    uint64_t g_pat;                     /* 0x668 */
+    uint64_t dbgctl;                    /* 0x670 */
+    uint64_t br_from;                   /* 0x678 */
+    uint64_t br_to;                     /* 0x680 */
+    uint64_t last_excp_from;            /* 0x688 */
+    uint64_t last_excp_to;              /* 0x690 */
+    uint8_t  _rsvd11[0x1000 - 0x698];
+};
+
+#endif /* XTF_X86_X86_SVM_H */
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -38,7 +38,169 @@
 
 
 /* VMCS field encodings. */
+
+/* 16bit guest state. */
+#define VMCS_GUEST_ES_SEL                       0x0800
+#define VMCS_GUEST_CS_SEL                       0x0802
+#define VMCS_GUEST_SS_SEL                       0x0804
+#define VMCS_GUEST_DS_SEL                       0x0806
+#define VMCS_GUEST_FS_SEL                       0x0808
+#define VMCS_GUEST_GS_SEL                       0x080a
+#define VMCS_GUEST_LDTR_SEL                     0x080c
+#define VMCS_GUEST_TR_SEL                       0x080e
+
+/* 16bit host state. */
+#define VMCS_HOST_ES_SEL                        0x0c00
+#define VMCS_HOST_CS_SEL                        0x0c02
+#define VMCS_HOST_SS_SEL                        0x0c04
+#define VMCS_HOST_DS_SEL                        0x0c06
+#define VMCS_HOST_FS_SEL                        0x0c08
+#define VMCS_HOST_GS_SEL                        0x0c0a
+#define VMCS_HOST_TR_SEL                        0x0c0c
+
+/* 64bit control. */
+#define VMCS_MSR_BITMAP                         0x2004
+#define VMCS_TSC_OFFSET                         0x2010
+#define VMCS_VMREAD_BITMAP                      0x2026
+#define VMCS_VMWRITE_BITMAP                     0x2028
+
+/* 64bit guest state. */
+#define VMCS_LINK_PTR                           0x2800
+#define VMCS_GUEST_DEBUGCTL                     0x2802
+
+/* 32bit control. */
+#define VMCS_PIN_CTLS                           0x4000
+#define VMCS_PROC_CTLS                          0x4002
+#define VMCS_EXCEPTION_BITMAP                   0x4004
+#define VMCS_CR3_TARGET_COUNT                   0x400a
+#define VMCS_EXIT_CTLS                          0x400c
+#define VMCS_EXIT_MSR_STORE_COUNT               0x400e
+#define VMCS_EXIT_MSR_LOAD_COUNT                0x4010
+#define VMCS_ENTRY_CTLS                         0x4012
+#define VMCS_ENTRY_MSR_LOAD_COUNT               0x4014
+#define VMCS_ENTRY_INTR_INFO                    0x4016
+#define VMCS_PROC_CTLS2                         0x401e
+
+/* 32bit read-only data. */
 #define VMCS_VM_INSN_ERR                        0x4400
+#define VMCS_EXIT_REASON                        0x4402
+#define VMCS_EXIT_INTR_INFO                     0x4404
+#define VMCS_EXIT_INSN_LEN                      0x440c
+
+/* 32bit guest state. */
+#define VMCS_GUEST_ES_LIMIT                     0x4800
+#define VMCS_GUEST_CS_LIMIT                     0x4802
+#define VMCS_GUEST_SS_LIMIT                     0x4804
+#define VMCS_GUEST_DS_LIMIT                     0x4806
+#define VMCS_GUEST_FS_LIMIT                     0x4808
+#define VMCS_GUEST_GS_LIMIT                     0x480a
+#define VMCS_GUEST_LDTR_LIMIT                   0x480c
+#define VMCS_GUEST_TR_LIMIT                     0x480e
+#define VMCS_GUEST_GDTR_LIMIT                   0x4810
+#define VMCS_GUEST_IDTR_LIMIT                   0x4812
+#define VMCS_GUEST_ES_AR                        0x4814
+#define VMCS_GUEST_CS_AR                        0x4816
+#define VMCS_GUEST_SS_AR                        0x4818
+#define VMCS_GUEST_DS_AR                        0x481a
+#define VMCS_GUEST_FS_AR                        0x481c
+#define VMCS_GUEST_GS_AR                        0x481e
+#define VMCS_GUEST_LDTR_AR                      0x4820
+#define VMCS_GUEST_TR_AR                        0x4822
+#define VMCS_GUEST_INTR_STATE                   0x4824
+#define VMCS_GUEST_ACTIVITY_STATE               0x4826
+#define VMCS_GUEST_SYSENTER_CS                  0x482a
+
+/* 32bit host state. */
+#define VMCS_HOST_SYSENTER_CS                   0x4c00
+
+/* Natural width control. */
+#define VMCS_CR0_MASK                           0x6000
+#define VMCS_CR4_MASK                           0x6002
+#define VMCS_CR0_READ_SHADOW                    0x6004
+#define VMCS_CR4_READ_SHADOW                    0x6006
+
+/* Natural width read-only data. */
+#define VMCS_EXIT_QUAL                          0x6400
+
+/* Natural width guest state. */
+#define VMCS_GUEST_CR0                          0x6800
+#define VMCS_GUEST_CR3                          0x6802
+#define VMCS_GUEST_CR4                          0x6804
+#define VMCS_GUEST_ES_BASE                      0x6806
+#define VMCS_GUEST_CS_BASE                      0x6808
+#define VMCS_GUEST_SS_BASE                      0x680a
+#define VMCS_GUEST_DS_BASE                      0x680c
+#define VMCS_GUEST_FS_BASE                      0x680e
+#define VMCS_GUEST_GS_BASE                      0x6810
+#define VMCS_GUEST_LDTR_BASE                    0x6812
+#define VMCS_GUEST_TR_BASE                      0x6814
+#define VMCS_GUEST_GDTR_BASE                    0x6816
+#define VMCS_GUEST_IDTR_BASE                    0x6818
+#define VMCS_GUEST_DR7                          0x681a
+#define VMCS_GUEST_RSP                          0x681c
+#define VMCS_GUEST_RIP                          0x681e
+#define VMCS_GUEST_RFLAGS                       0x6820
+#define VMCS_GUEST_PENDING_DBG                  0x6822
+#define VMCS_GUEST_SYSENTER_ESP                 0x6824
+#define VMCS_GUEST_SYSENTER_EIP                 0x6826
+
+/* Natural width host state. */
+#define VMCS_HOST_CR0                           0x6c00
+#define VMCS_HOST_CR3                           0x6c02
+#define VMCS_HOST_CR4                           0x6c04
+#define VMCS_HOST_FS_BASE                       0x6c06
+#define VMCS_HOST_GS_BASE                       0x6c08
+#define VMCS_HOST_TR_BASE                       0x6c0a
+#define VMCS_HOST_GDTR_BASE                     0x6c0c
+#define VMCS_HOST_IDTR_BASE                     0x6c0e
+#define VMCS_HOST_SYSENTER_ESP                  0x6c10
+#define VMCS_HOST_SYSENTER_EIP                  0x6c12
+#define VMCS_HOST_RSP                           0x6c14
+#define VMCS_HOST_RIP                           0x6c16
+
+/* 64bit fields are accessed in two halves in 32bit mode. */
+#define VMCS_HIGH(field)                        ((field) + 1)
+
+
+/* Pin-based VM-execution controls. */
+#define VMX_PIN_EXT_INTR_EXITING                (1u <<  0)
+#define VMX_PIN_NMI_EXITING                     (1u <<  3)
+
+/* Primary processor-based VM-execution controls. */
+#define VMX_PROC_HLT_EXITING                    (1u <<  7)
+#define VMX_PROC_USE_MSR_BITMAPS                (1u << 28)
+#define VMX_PROC_ACTIVATE_CTLS2                 (1u << 31)
+
+/* Secondary processor-based VM-execution controls. */
+#define VMX_PROC2_VMCS_SHADOWING                (1u << 14)
+
+/* VM-exit controls. */
+#define VMX_EXIT_HOST_ADDR_SPACE_SIZE           (1u <<  9)
+
+/* VM-entry controls. */
+#define VMX_ENTRY_IA32E_MODE                    (1u <<  9)
+
+/* Segment access rights, beyond those in the descriptor. */
+#define VMX_AR_UNUSABLE                         (1u << 16)
+
+/* VMCS link pointer value when not in use. */
+#define VMX_LINK_PTR_NONE                       (~0ull)
+
+
+/* Basic exit reasons. */
+#define VMX_EXIT_EXCEPTION_NMI                   0
+#define VMX_EXIT_EXTERNAL_INTERRUPT              1
+#define VMX_EXIT_TRIPLE_FAULT                    2
+#define VMX_EXIT_CPUID                          10
+#define VMX_EXIT_HLT                            12
+#define VMX_EXIT_VMCALL                         18
+#define VMX_EXIT_VMREAD                         23
+#define VMX_EXIT_VMWRITE                        25
+#define VMX_EXIT_INVALID_GUEST_STATE            33
+#define VMX_EXIT_MSR_LOADING                    34
+
+/* Set in the exit reason when VM entry fails after loading guest state. */
+#define VMX_EXIT_REASON_FAILED_ENTRY            (1u << 31)
 
 #endif /* XTF_X86_X86_VMX_H */
 
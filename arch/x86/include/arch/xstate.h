@@ -0,0 +1,47 @@
+/**
+ * @file arch/x86/include/arch/xstate.h
+ *
+ * Helpers for enabling FPU, SSE and XSAVE-managed vector state.
+ *
+ * XTF is compiled without vector code, and runs with the FPU state in its
+ * reset configuration.  Tests wanting vector state in use (e.g. to exercise
+ * Xen's context switching of it) enable the components they need, then call
+ * into code listed in obj-simd.
+ */
+#ifndef XTF_X86_XSTATE_H
+#define XTF_X86_XSTATE_H
+
+#include <xtf/types.h>
+
+#include <arch/processor.h>
+
+/* AVX-512 state, which can only be enabled together. */
+#define XSTATE_AVX512 (XSTATE_OPMASK | XSTATE_ZMM | XSTATE_HI_ZMM)
+
+/**
+ * The XSTATE_* components which xstate_enable() can enable.  Without XSAVE,
+ * this is at most x87 and SSE.
+ */
+uint64_t xstate_available(void);
+
+/**
+ * Enable the XSTATE_* components in @p mask, clearing CR0.EM/TS, setting
+ * CR4.OSFXSR/OSXMMEXCPT, and setting CR4.OSXSAVE and XCR0 if XSAVE is
+ * available.  x87 state is always enabled.  HVM environments only.
+ *
+ * @returns 0 on success, -EOPNOTSUPP if a component isn't available, or
+ * -EINVAL if @p mask violates XCR0's dependencies (e.g. YMM without SSE).
+ */
+int xstate_enable(uint64_t mask);
+
+#endif /* XTF_X86_XSTATE_H */
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -42,6 +42,19 @@ int ioapic_set_mask(unsigned int entry, bool mask)
     return 0;
 }
 
+int ioapic_set_redir(unsigned int entry, unsigned int vector,
+                     unsigned int dest, bool level)
+{
+    if ( entry >= nr_entries )
+        return -EINVAL;
+
+    ioapic_write64(IOAPIC_REDIR_ENTRY(entry),
+                   ((uint64_t)dest << IOAPIC_REDIR_DEST_SHIFT) |
+                   (level ? IOAPIC_REDIR_LEVEL : 0) | vector);
+
+    return 0;
+}
+
 /*
  * Local variables:
  * mode: C
@@ -0,0 +1,255 @@
+/**
+ * @file arch/x86/pmu.c
+ *
+ * Helpers for the Performance Monitoring Unit.
+ */
+#include <xtf/lib.h>
+
+#include <arch/cpuid.h>
+#include <arch/lib.h>
+#include <arch/msr.h>
+#include <arch/pmu.h>
+
+#include <xen/errno.h>
+
+/* CPUID 0x80000001.ecx: AMD core performance counter extensions. */
+#define AMD_PERFCTR_CORE (1u << 23)
+
+/* CPUID 0xa.ebx: set bits are architectural events *not* available. */
+#define ARCH_EVT_CYCLES       (1u << 0)
+#define ARCH_EVT_INSTRUCTIONS (1u << 1)
+#define ARCH_EVT_LLC_MISSES   (1u << 4)
+
+/*
+ * Event select encodings, as (umask << 8) | event.  0 means the event isn't
+ * available from the core counters of that vendor.
+ */
+static const struct {
+    const char *name;
+    uint16_t intel, amd;
+} events[PMU_NR_EVENTS] = {
+    [PMU_CYCLES]       = { "cycles",       0x003c, 0x0076 },
+    [PMU_INSTRUCTIONS] = { "instructions", 0x00c0, 0x00c0 },
+    [PMU_DTLB_MISSES]  = { "dTLB misses",  0x0108, 0xff45 },
+    [PMU_LLC_MISSES]   = { "LLC misses",   0x412e, 0      },
+};
+
+static unsigned int nr_ctrs, ctr_width, intel_version;
+static bool amd_core, use_rdpmc;
+
+/* Architectural events the CPU doesn't support, from CPUID 0xa.ebx. */
+static uint32_t intel_unavail;
+
+/* Counter assigned to each event, or -1. */
+static int ctr_of[PMU_NR_EVENTS] = { -1, -1, -1, -1 };
+
+static uint32_t ctl_msr(unsigned int n)
+{
+    if ( vendor_is_intel )
+        return MSR_PERFEVTSEL(n);
+
+    return amd_core ? MSR_F15H_PERFCTL(n) : MSR_K7_PERFCTL(n);
+}
+
+static uint32_t ctr_msr(unsigned int n)
+{
+    if ( vendor_is_intel )
+        return MSR_PMC(n);
+
+    return amd_core ? MSR_F15H_PERFCTR(n) : MSR_K7_PERFCTR(n);
+}
+
+static uint16_t encoding(enum pmu_event e)
+{
+    static const uint32_t arch_bit[PMU_NR_EVENTS] = {
+        [PMU_CYCLES]       = ARCH_EVT_CYCLES,
+        [PMU_INSTRUCTIONS] = ARCH_EVT_INSTRUCTIONS,
+        [PMU_LLC_MISSES]   = ARCH_EVT_LLC_MISSES,
+    };
+
+    if ( !vendor_is_intel )
+        return events[e].amd;
+
+    if ( intel_unavail & arch_bit[e] )
+        return 0;
+
+    /* The dTLB event isn't architectural, and only known for family 6. */
+    if ( e == PMU_DTLB_MISSES && x86_family != 6 )
+        return 0;
+
+    return events[e].intel;
+}
+
+/* Read counter @p n.  Returns true if `rdpmc` faulted. */
+static bool rdpmc_safe(unsigned int n, uint64_t *val)
+{
+    unsigned long fault = 0;
+    uint32_t lo, hi;
+
+    asm volatile ("1: rdpmc; 2:"
+                  _ASM_EXTABLE_HANDLER(1b, 2b, %P[rec])
+                  : "=a" (lo), "=d" (hi), "+D" (fault)
+                  : "c" (n), [rec] "p" (ex_record_fault_edi));
+
+    *val = ((uint64_t)hi << 32) | lo;
+
+    return fault;
+}
+
+static uint64_t read_ctr(unsigned int n)
+{
+    uint32_t lo, hi;
+
+    if ( !use_rdpmc )
+        return rdmsr(ctr_msr(n));
+
+    asm volatile ("rdpmc" : "=a" (lo), "=d" (hi) : "c" (n));
+
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/*
+ * Count cycles in counter 0 across a short loop.  With vPMU disabled, Xen
+ * either faults the MSR accesses, or discards the writes.
+ */
+static bool probe_counting(void)
+{
+    uint64_t val;
+
+    if ( wrmsr_safe(ctl_msr(0), 0) || wrmsr_safe(ctr_msr(0), 0) )
+        return false;
+
+    if ( intel_version >= 2 &&
+         wrmsr_safe(MSR_PERF_GLOBAL_CTRL, 1) )
+        return false;
+
+    wrmsr(ctl_msr(0), (encoding(PMU_CYCLES) | PERFEVTSEL_USR |
+                       PERFEVTSEL_OS | PERFEVTSEL_EN));
+
+    for ( unsigned int i = 0; i < 1000; ++i )
+        barrier();
+
+    wrmsr(ctl_msr(0), 0);
+    if ( intel_version >= 2 )
+        wrmsr(MSR_PERF_GLOBAL_CTRL, 0);
+
+    if ( rdmsr_safe(ctr_msr(0), &val) || val == 0 )
+        return false;
+
+    use_rdpmc = !rdpmc_safe(0, &val);
+
+    return true;
+}
+
+int pmu_init(void)
+{
+    uint32_t eax, ebx, ecx, edx;
+
+    if ( vendor_is_intel )
+    {
+        if ( max_leaf < 0xa )
+            return -ENODEV;
+
+        cpuid(0xa, &eax, &ebx, &ecx, &edx);
+
+        intel_version = eax & 0xff;
+        nr_ctrs       = (eax >> 8) & 0xff;
+        ctr_width     = (eax >> 16) & 0xff;
+
+        /* Events beyond the length of the EBX vector are unavailable. */
+        intel_unavail = ebx;
+        if ( (eax >> 24) < 32 )
+            intel_unavail |= ~0u << (eax >> 24);
+
+        if ( intel_version == 0 || nr_ctrs == 0 ||
+             (intel_unavail & ARCH_EVT_CYCLES) )
+            return -ENODEV;
+    }
+    else if ( vendor_is_amd )
+    {
+        if ( max_extd_leaf >= 0x80000001 )
+        {
+            cpuid(0x80000001, &eax, &ebx, &ecx, &edx);
+            amd_core = ecx & AMD_PERFCTR_CORE;
+        }
+
+        nr_ctrs   = amd_core ? 6 : 4;
+        ctr_width = 48;
+    }
+    else
+        return -ENODEV;
+
+    return probe_counting() ? 0 : -ENODEV;
+}
+
+unsigned int pmu_enable(unsigned int mask)
+{
+    unsigned int n = 0, enabled = 0;
+    uint64_t global = 0;
+
+    pmu_disable();
+
+    for ( unsigned int e = 0; e < PMU_NR_EVENTS && n < nr_ctrs; ++e )
+    {
+        uint16_t enc = encoding(e);
+
+        if ( !(mask & PMU_EVENT(e)) || !enc )
+            continue;
+
+        wrmsr(ctr_msr(n), 0);
+        wrmsr(ctl_msr(n), enc | PERFEVTSEL_USR | PERFEVTSEL_OS | PERFEVTSEL_EN);
+
+        global |= 1ull << n;
+        enabled |= PMU_EVENT(e);
+        ctr_of[e] = n++;
+    }
+
+    if ( intel_version >= 2 )
+        wrmsr(MSR_PERF_GLOBAL_CTRL, global);
+
+    return enabled;
+}
+
+void pmu_disable(void)
+{
+    if ( intel_version >= 2 )
+        wrmsr(MSR_PERF_GLOBAL_CTRL, 0);
+
+    for ( unsigned int e = 0; e < PMU_NR_EVENTS; ++e )
+    {
+        if ( ctr_of[e] < 0 )
+            continue;
+
+        wrmsr(ctl_msr(ctr_of[e]), 0);
+        ctr_of[e] = -1;
+    }
+}
+
+void pmu_read(struct pmu_sample *s)
+{
+    for ( unsigned int e = 0; e < PMU_NR_EVENTS; ++e )
+        s->ctr[e] = ctr_of[e] < 0 ? 0 : read_ctr(ctr_of[e]);
+}
+
+uint64_t pmu_delta(const struct pmu_sample *start,
+                   const struct pmu_sample *end, enum pmu_event e)
+{
+    uint64_t mask = ctr_width >= 64 ? ~0ull : (1ull << ctr_width) - 1;
+
+    return (end->ctr[e] - start->ctr[e]) & mask;
+}
+
+const char *pmu_event_name(enum pmu_event e)
+{
+    return e < PMU_NR_EVENTS ? events[e].name : "unknown";
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,113 @@
+/**
+ * @file arch/x86/pv/mmu-batch.c
+ *
+ * Batching of PV pagetable updates.
+ */
+#include <xtf/lib.h>
+#include <xtf/multicall.h>
+
+#include <arch/mmu-batch.h>
+#include <arch/pagetable.h>
+#include <arch/traps.h>
+
+void mmu_batch_init(struct mmu_batch *b, unsigned int flags)
+{
+    b->nr = 0;
+    b->flags = flags;
+}
+
+int mmu_batch_add(struct mmu_batch *b, uint64_t l1e,
+                  unsigned long linear, intpte_t val)
+{
+    unsigned int i = b->nr++;
+
+    b->reqs[i] = (mmu_update_t){
+        .ptr = l1e | MMU_NORMAL_PT_UPDATE,
+        .val = val,
+    };
+
+    if ( (b->flags & UVMF_FLUSHTYPE_MASK) == UVMF_INVLPG )
+        b->ops[i] = (mmuext_op_t){
+            .cmd = (b->flags & UVMF_ALL) ? MMUEXT_INVLPG_ALL
+                                         : MMUEXT_INVLPG_LOCAL,
+            .arg1.linear_addr = linear,
+        };
+
+    if ( b->nr == ARRAY_SIZE(b->reqs) )
+        return mmu_batch_flush(b);
+
+    return 0;
+}
+
+int mmu_batch_flush(struct mmu_batch *b)
+{
+    unsigned int nr = b->nr, nr_ops = 0;
+
+    if ( !nr )
+        return 0;
+
+    b->nr = 0;
+
+    switch ( b->flags & UVMF_FLUSHTYPE_MASK )
+    {
+    case UVMF_INVLPG:
+        /* ops[] populated by mmu_batch_add(). */
+        nr_ops = nr;
+        break;
+
+    case UVMF_TLB_FLUSH:
+        b->ops[0] = (mmuext_op_t){
+            .cmd = (b->flags & UVMF_ALL) ? MMUEXT_TLB_FLUSH_ALL
+                                         : MMUEXT_TLB_FLUSH_LOCAL,
+        };
+        nr_ops = 1;
+        break;
+    }
+
+    if ( !nr_ops )
+        return hypercall_mmu_update(b->reqs, nr, NULL, DOMID_SELF);
+
+    /* Issue the updates and the flush in a single transition into Xen. */
+    multicall_entry_t ents[2];
+    struct mc_batch mc;
+
+    mc_begin(&mc, ents, ARRAY_SIZE(ents));
+    mc_add_mmu_update(&mc, b->reqs, nr, NULL, DOMID_SELF);
+    mc_add_mmuext_op(&mc, b->ops, nr_ops, NULL, DOMID_SELF);
+
+    return mc_flush(&mc);
+}
+
+uint64_t pv_l1e_maddr(unsigned long linear)
+{
+    intpte_t *tab = _p(pv_start_info->pt_base);
+    const unsigned int idx[] = {
+#if CONFIG_PAGING_LEVELS == 4
+        l4_table_offset(linear),
+#endif
+        l3_table_offset(linear),
+        l2_table_offset(linear),
+    };
+
+    for ( unsigned int i = 0; i < ARRAY_SIZE(idx); ++i )
+    {
+        intpte_t pte = tab[idx[i]];
+
+        if ( (pte & (_PAGE_PRESENT | _PAGE_PSE)) != _PAGE_PRESENT )
+            return 0;
+
+        tab = maddr_to_virt(pte_to_paddr(pte));
+    }
+
+    return virt_to_maddr(&tab[l1_table_offset(linear)]);
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,171 @@
+/**
+ * @file arch/x86/svm.c
+ *
+ * Helpers for SVM.
+ */
+#include <xtf/lib.h>
+
+#include <arch/cpuid.h>
+#include <arch/desc.h>
+#include <arch/lib.h>
+#include <arch/msr.h>
+#include <arch/page.h>
+#include <arch/svm.h>
+
+#include <xen/errno.h>
+
+#ifdef __x86_64__
+/* Identity nested pagetables for the first 1GB, in 2M superpages. */
+static uint64_t npt_l4[512] __page_aligned_bss;
+static uint64_t npt_l3[512] __page_aligned_bss;
+static uint64_t npt_l2[512] __page_aligned_bss;
+#endif
+
+int svm_enable(void *hsave)
+{
+    uint64_t vm_cr;
+
+    if ( !cpu_has_svm || rdmsr_safe(MSR_VM_CR, &vm_cr) ||
+         (vm_cr & VM_CR_SVMDIS) )
+        return -ENODEV;
+
+    wrmsr(MSR_EFER, rdmsr(MSR_EFER) | EFER_SVME);
+    wrmsr(MSR_VM_HSAVE_PA, _u(hsave));
+
+    return 0;
+}
+
+void svm_disable(void)
+{
+    wrmsr(MSR_EFER, rdmsr(MSR_EFER) & ~EFER_SVME);
+}
+
+/* Fill @p seg from the descriptor @p sel refers to. */
+static void init_seg(struct vmcb_seg *seg, unsigned int sel)
+{
+    const user_desc *d = &gdt[sel >> 3];
+
+    *seg = (struct vmcb_seg){ .sel = sel };
+
+    if ( !(sel & ~3) )
+        return;
+
+    seg->attr  = ((d->hi >> 8) & 0xff) | ((d->hi >> 12) & 0xf00);
+    seg->limit = user_desc_limit(d);
+    seg->base  = user_desc_base(d);
+}
+
+void svm_init_vmcb(struct vmcb *vmcb, void (*entry)(void), void *stack)
+{
+    desc_ptr gdtr, idtr;
+
+    BUILD_BUG_ON(sizeof(*vmcb) != PAGE_SIZE);
+    BUILD_BUG_ON(offsetof(struct vmcb, rax) != 0x5f8);
+
+    memset(vmcb, 0, sizeof(*vmcb));
+
+    vmcb->intercept2 = SVM_INTERCEPT2_VMRUN | SVM_INTERCEPT2_VMMCALL;
+    vmcb->asid = 1;
+
+    sgdt(&gdtr);
+    sidt(&idtr);
+
+    init_seg(&vmcb->es, read_es());
+    init_seg(&vmcb->cs, read_cs());
+    init_seg(&vmcb->ss, read_ss());
+    init_seg(&vmcb->ds, read_ds());
+    init_seg(&vmcb->fs, read_fs());
+    init_seg(&vmcb->gs, read_gs());
+    init_seg(&vmcb->tr, str());
+    vmcb->tr.base  = _u(&tss);
+    vmcb->tr.limit = sizeof(tss) - 1;
+
+    vmcb->gdtr.base  = gdtr.base;
+    vmcb->gdtr.limit = gdtr.limit;
+    vmcb->idtr.base  = idtr.base;
+    vmcb->idtr.limit = idtr.limit;
+
+    vmcb->efer   = rdmsr(MSR_EFER);
+    vmcb->cr0    = read_cr0();
+    vmcb->cr3    = read_cr3();
+    vmcb->cr4    = read_cr4();
+    vmcb->dr6    = 0xffff0ff0;
+    vmcb->dr7    = 0x400;
+    vmcb->rflags = X86_EFLAGS_MBS;
+    vmcb->rip    = _u(entry);
+    vmcb->rsp    = _u(stack);
+    vmcb->g_pat  = rdmsr(MSR_PAT);
+
+    vmcb->sysenter_cs  = rdmsr(MSR_SYSENTER_CS);
+    vmcb->sysenter_esp = rdmsr(MSR_SYSENTER_ESP);
+    vmcb->sysenter_eip = rdmsr(MSR_SYSENTER_EIP);
+
+    if ( IS_DEFINED(CONFIG_64BIT) )
+    {
+        vmcb->fs.base = rdmsr(MSR_FS_BASE);
+        vmcb->gs.base = rdmsr(MSR_GS_BASE);
+        vmcb->kernel_gs_base = rdmsr(MSR_SHADOW_GS_BASE);
+        vmcb->star   = rdmsr(MSR_STAR);
+        vmcb->lstar  = rdmsr(MSR_LSTAR);
+        vmcb->cstar  = rdmsr(MSR_CSTAR);
+        vmcb->sfmask = rdmsr(MSR_FMASK);
+    }
+}
+
+int svm_enable_npt(struct vmcb *vmcb)
+{
+#ifdef __x86_64__
+    uint32_t eax, ebx, ecx, edx;
+    const uint64_t flags = _PAGE_AD | _PAGE_USER | _PAGE_RW | _PAGE_PRESENT;
+
+    cpuid(0x8000000a, &eax, &ebx, &ecx, &edx);
+    if ( !(edx & SVM_FEATURE_NPT) )
+        return -EOPNOTSUPP;
+
+    /* Nested walks are user accesses, so every level needs _PAGE_USER. */
+    npt_l4[0] = _u(npt_l3) | flags;
+    npt_l3[0] = _u(npt_l2) | flags;
+    for ( unsigned int i = 0; i < ARRAY_SIZE(npt_l2); ++i )
+        npt_l2[i] = ((uint64_t)i << PAE_L2_PT_SHIFT) | _PAGE_PSE | flags;
+
+    vmcb->np_ctrl = VMCB_NP_ENABLE;
+    vmcb->n_cr3 = _u(npt_l4);
+
+    return 0;
+#else
+    return -EOPNOTSUPP;
+#endif
+}
+
+void svm_enter(struct vmcb *vmcb)
+{
+    unsigned long paddr = _u(vmcb);
+
+    /*
+     * vmrun saves and restores the host's %rax, %rsp, %rip and %rflags, but
+     * no other GPRs.  GIF is held clear across the world switch, and #VMEXIT
+     * leaves it clear, so set it again afterwards.
+     */
+    asm volatile ("push %%" _ASM_BP ";"
+                  "clgi;"
+                  "vmrun;"
+                  "stgi;"
+                  "pop %%" _ASM_BP ";"
+                  : "+a" (paddr)
+                  :
+                  : "memory", "bx", "cx", "dx", "si", "di"
+#ifdef __x86_64__
+                    , "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"
+#endif
+        );
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -75,11 +75,6 @@ void __weak do_sysenter(struct cpu_regs *regs)
     panic("Unhandled sysenter\n");
 }
 
-void __weak do_evtchn(struct cpu_regs *regs)
-{
-    panic("Unhandled evtchn upcall\n");
-}
-
 /*
  * Local variables:
  * mode: C
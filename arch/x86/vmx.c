@@ -5,8 +5,20 @@
  */
 #include <xtf/lib.h>
 
+#include <arch/cpuid.h>
+#include <arch/desc.h>
+#include <arch/lib.h>
+#include <arch/msr.h>
+#include <arch/page.h>
 #include <arch/vmx.h>
 
+#include <xen/errno.h>
+
+/* State of the current VMCS, for vmx_enter(). */
+static bool vmcs_launched;
+static unsigned long vmcs_host_sp;
+static bool vmx_entry_failed;
+
 const char *vmx_insn_err_strerror(unsigned int err)
 {
 #define ERR(x) [VMERR_ ## x] = #x
@@ -45,6 +57,237 @@ const char *vmx_insn_err_strerror(unsigned int err)
         return "<unknown>";
 }
 
+int vmx_enable(void *vmxon_region)
+{
+    msr_vmx_basic_t basic;
+    unsigned long cr0 = read_cr0(), cr4 = read_cr4();
+
+    if ( !cpu_has_vmx || rdmsr_safe(MSR_VMX_BASIC, &basic.raw) )
+        return -ENODEV;
+
+    cr0 = (cr0 | rdmsr(MSR_VMX_CR0_FIXED0)) & rdmsr(MSR_VMX_CR0_FIXED1);
+    cr4 = (cr4 | rdmsr(MSR_VMX_CR4_FIXED0) | X86_CR4_VMXE) &
+        rdmsr(MSR_VMX_CR4_FIXED1);
+
+    write_cr0(cr0);
+    write_cr4(cr4);
+
+    memset(vmxon_region, 0, PAGE_SIZE);
+    *(uint32_t *)vmxon_region = basic.vmcs_rev_id;
+
+    return vmxon(_u(vmxon_region)) ? 0 : -EIO;
+}
+
+void vmx_disable(void)
+{
+    vmxoff();
+    write_cr4(read_cr4() & ~X86_CR4_VMXE);
+}
+
+/*
+ * Adjust @p ctls against the capability MSR @p msr.  Returns false if a
+ * requested control isn't supported.
+ */
+static bool adjust_ctls(uint32_t msr, uint32_t *ctls)
+{
+    uint64_t caps = rdmsr(msr);
+    uint32_t allowed0 = caps, allowed1 = caps >> 32;
+
+    if ( *ctls & ~allowed1 )
+        return false;
+
+    *ctls |= allowed0;
+
+    return true;
+}
+
+/* Segment access rights, from the descriptor @p sel refers to. */
+static uint32_t seg_ar(unsigned int sel)
+{
+    if ( !(sel & ~3) )
+        return VMX_AR_UNUSABLE;
+
+    return (gdt[sel >> 3].hi >> 8) & 0xf0ff;
+}
+
+/*
+ * Write guest and host state for segment @p idx, in the VMCS order of ES, CS,
+ * SS, DS, FS, GS, whose fields are each 2 apart.
+ */
+static bool write_seg(unsigned int idx, unsigned int sel)
+{
+    unsigned long base = 0, limit = 0;
+
+    if ( sel & ~3 )
+    {
+        base = user_desc_base(&gdt[sel >> 3]);
+        limit = user_desc_limit(&gdt[sel >> 3]);
+    }
+
+    return (vmwrite(VMCS_GUEST_ES_SEL + idx * 2, sel) &&
+            vmwrite(VMCS_GUEST_ES_BASE + idx * 2, base) &&
+            vmwrite(VMCS_GUEST_ES_LIMIT + idx * 2, limit) &&
+            vmwrite(VMCS_GUEST_ES_AR + idx * 2, seg_ar(sel)) &&
+            vmwrite(VMCS_HOST_ES_SEL + idx * 2, sel & ~3));
+}
+
+int vmx_init_vmcs(void *vmcs, void (*entry)(void), void *stack,
+                  uint32_t proc_ctls, uint32_t proc_ctls2)
+{
+    msr_vmx_basic_t basic = { rdmsr(MSR_VMX_BASIC) };
+    uint32_t pin = 0, exit = 0, entry_ctls = 0;
+    unsigned int true_off = basic.true_ctls ? 0xc : 0;
+    unsigned long cr0 = read_cr0(), cr4 = read_cr4();
+    desc_ptr gdtr, idtr;
+    bool ok;
+
+    if ( !(cr0 & X86_CR0_PG) )
+        return -EOPNOTSUPP;
+
+    if ( IS_DEFINED(CONFIG_64BIT) )
+    {
+        exit |= VMX_EXIT_HOST_ADDR_SPACE_SIZE;
+        entry_ctls |= VMX_ENTRY_IA32E_MODE;
+    }
+
+    if ( proc_ctls2 )
+        proc_ctls |= VMX_PROC_ACTIVATE_CTLS2;
+
+    /* The TRUE_* MSRs are 0xc above their counterparts. */
+    if ( !adjust_ctls(MSR_VMX_PINBASED_CTLS + true_off, &pin) ||
+         !adjust_ctls(MSR_VMX_PROCBASED_CTLS + true_off, &proc_ctls) ||
+         !adjust_ctls(MSR_VMX_EXIT_CTLS + true_off, &exit) ||
+         !adjust_ctls(MSR_VMX_ENTRY_CTLS + true_off, &entry_ctls) ||
+         (proc_ctls2 && !adjust_ctls(MSR_VMX_PROCBASED_CTLS2, &proc_ctls2)) )
+        return -EOPNOTSUPP;
+
+    memset(vmcs, 0, PAGE_SIZE);
+    *(uint32_t *)vmcs = basic.vmcs_rev_id;
+
+    if ( !vmclear(_u(vmcs)) || !vmptrld(_u(vmcs)) )
+        return -EIO;
+
+    vmcs_launched = false;
+    vmcs_host_sp = 0;
+
+    sgdt(&gdtr);
+    sidt(&idtr);
+
+    ok = (/* Controls. */
+          vmwrite(VMCS_PIN_CTLS, pin) &&
+          vmwrite(VMCS_PROC_CTLS, proc_ctls) &&
+          (!proc_ctls2 || vmwrite(VMCS_PROC_CTLS2, proc_ctls2)) &&
+          vmwrite(VMCS_EXIT_CTLS, exit) &&
+          vmwrite(VMCS_ENTRY_CTLS, entry_ctls) &&
+          vmwrite(VMCS_EXCEPTION_BITMAP, 0) &&
+          vmwrite(VMCS_CR0_READ_SHADOW, cr0) &&
+          vmwrite(VMCS_CR4_READ_SHADOW, cr4) &&
+          vmwrite64(VMCS_LINK_PTR, VMX_LINK_PTR_NONE) &&
+
+          /* Host state.  %rsp and %rip are written by vmx_enter(). */
+          vmwrite(VMCS_HOST_CR0, cr0) &&
+          vmwrite(VMCS_HOST_CR3, read_cr3()) &&
+          vmwrite(VMCS_HOST_CR4, cr4) &&
+          vmwrite(VMCS_HOST_TR_SEL, str()) &&
+          vmwrite(VMCS_HOST_FS_BASE,
+                  IS_DEFINED(CONFIG_64BIT) ? rdmsr(MSR_FS_BASE) : 0) &&
+          vmwrite(VMCS_HOST_GS_BASE,
+                  IS_DEFINED(CONFIG_64BIT) ? rdmsr(MSR_GS_BASE) : 0) &&
+          vmwrite(VMCS_HOST_TR_BASE, _u(&tss)) &&
+          vmwrite(VMCS_HOST_GDTR_BASE, gdtr.base) &&
+          vmwrite(VMCS_HOST_IDTR_BASE, idtr.base) &&
+          vmwrite(VMCS_HOST_SYSENTER_CS, rdmsr(MSR_SYSENTER_CS)) &&
+          vmwrite(VMCS_HOST_SYSENTER_ESP, rdmsr(MSR_SYSENTER_ESP)) &&
+          vmwrite(VMCS_HOST_SYSENTER_EIP, rdmsr(MSR_SYSENTER_EIP)) &&
+
+          /* Guest state, mirroring the host. */
+          write_seg(0, read_es()) &&
+          write_seg(1, read_cs()) &&
+          write_seg(2, read_ss()) &&
+          write_seg(3, read_ds()) &&
+          write_seg(4, read_fs()) &&
+          write_seg(5, read_gs()) &&
+          vmwrite(VMCS_GUEST_LDTR_SEL, 0) &&
+          vmwrite(VMCS_GUEST_LDTR_AR, VMX_AR_UNUSABLE) &&
+          vmwrite(VMCS_GUEST_TR_SEL, str()) &&
+          vmwrite(VMCS_GUEST_TR_BASE, _u(&tss)) &&
+          vmwrite(VMCS_GUEST_TR_LIMIT, sizeof(tss) - 1) &&
+          vmwrite(VMCS_GUEST_TR_AR, seg_ar(str())) &&
+          vmwrite(VMCS_GUEST_GDTR_BASE, gdtr.base) &&
+          vmwrite(VMCS_GUEST_GDTR_LIMIT, gdtr.limit) &&
+          vmwrite(VMCS_GUEST_IDTR_BASE, idtr.base) &&
+          vmwrite(VMCS_GUEST_IDTR_LIMIT, idtr.limit) &&
+          vmwrite(VMCS_GUEST_CR0, cr0) &&
+          vmwrite(VMCS_GUEST_CR3, read_cr3()) &&
+          vmwrite(VMCS_GUEST_CR4, cr4) &&
+          vmwrite(VMCS_GUEST_DR7, 0x400) &&
+          vmwrite(VMCS_GUEST_RSP, _u(stack)) &&
+          vmwrite(VMCS_GUEST_RIP, _u(entry)) &&
+          vmwrite(VMCS_GUEST_RFLAGS, X86_EFLAGS_MBS) &&
+          vmwrite64(VMCS_GUEST_DEBUGCTL, 0) &&
+          vmwrite(VMCS_GUEST_SYSENTER_CS, rdmsr(MSR_SYSENTER_CS)) &&
+          vmwrite(VMCS_GUEST_SYSENTER_ESP, rdmsr(MSR_SYSENTER_ESP)) &&
+          vmwrite(VMCS_GUEST_SYSENTER_EIP, rdmsr(MSR_SYSENTER_EIP)));
+
+    return ok ? 0 : -EIO;
+}
+
+bool vmx_relaunch(void *vmcs)
+{
+    vmcs_launched = false;
+
+    return vmclear(_u(vmcs)) && vmptrld(_u(vmcs));
+}
+
+bool vmx_enter(void)
+{
+    /*
+     * The host %rsp and %rip are only written when the stack pointer differs
+     * from last time, so a loop of entries costs no vmwrite's.  VM exit
+     * clears RFLAGS, so the flags are preserved across the guest.
+     */
+    asm volatile ("push %%" _ASM_BP ";"
+                  "pushf;"
+                  "cmp %%" _ASM_SP ", %[host_sp];"
+                  "je 1f;"
+                  "mov %%" _ASM_SP ", %[host_sp];"
+                  "mov $%c[f_rsp], %%eax;"
+                  "vmwrite %%" _ASM_SP ", %%" _ASM_AX ";"
+                  "mov $%c[f_rip], %%eax;"
+                  "mov $3f, %%" _ASM_CX ";"
+                  "vmwrite %%" _ASM_CX ", %%" _ASM_AX ";"
+                  "1:"
+                  "cmpb $0, %[launched];"
+                  "je 2f;"
+                  "vmresume;"
+                  "jmp 4f;"
+                  "2: vmlaunch;"
+                  "4: movb $1, %[failed];"   /* Fell through: VMfail. */
+                  "jmp 5f;"
+                  "3: movb $0, %[failed];"   /* VM exit. */
+                  "movb $1, %[launched];"
+                  "5: popf;"
+                  "pop %%" _ASM_BP ";"
+                  : [failed] "=m" (vmx_entry_failed),
+                    [launched] "+m" (vmcs_launched),
+                    [host_sp] "+m" (vmcs_host_sp)
+                  : [f_rsp] "i" (VMCS_HOST_RSP),
+                    [f_rip] "i" (VMCS_HOST_RIP)
+                  : "memory", "ax", "bx", "cx", "dx", "si", "di"
+#ifdef __x86_64__
+                    , "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"
+#endif
+        );
+
+    return !vmx_entry_failed;
+}
+
+void vmx_skip_insn(void)
+{
+    vmwrite(VMCS_GUEST_RIP, vmread(VMCS_GUEST_RIP) +
+            vmread(VMCS_EXIT_INSN_LEN));
+}
+
 /*
  * Local variables:
  * mode: C
@@ -0,0 +1,67 @@
+/**
+ * @file arch/x86/xstate.c
+ *
+ * Helpers for enabling FPU, SSE and XSAVE-managed vector state.
+ */
+#include <xtf/lib.h>
+
+#include <arch/cpuid.h>
+#include <arch/lib.h>
+#include <arch/xstate.h>
+
+#include <xen/errno.h>
+
+uint64_t xstate_available(void)
+{
+    uint32_t eax, ebx, ecx, edx;
+
+    if ( cpu_has_xsave )
+    {
+        cpuid_count(0xd, 0, &eax, &ebx, &ecx, &edx);
+
+        return ((uint64_t)edx << 32) | eax;
+    }
+
+    return XSTATE_FP | ((cpu_has_fxsr && cpu_has_sse) ? XSTATE_SSE : 0);
+}
+
+int xstate_enable(uint64_t mask)
+{
+    unsigned long cr4 = read_cr4();
+
+    mask |= XSTATE_FP;
+
+    if ( mask & ~xstate_available() )
+        return -EOPNOTSUPP;
+
+    if ( ((mask & XSTATE_YMM) && !(mask & XSTATE_SSE)) ||
+         ((mask & XSTATE_AVX512) &&
+          ((mask & XSTATE_AVX512) != XSTATE_AVX512 ||
+           !(mask & XSTATE_YMM))) )
+        return -EINVAL;
+
+    write_cr0((read_cr0() & ~(X86_CR0_EM | X86_CR0_TS)) | X86_CR0_MP);
+
+    if ( mask & XSTATE_SSE )
+        cr4 |= X86_CR4_OSFXSR | X86_CR4_OSXMMEXCPT;
+
+    if ( cpu_has_xsave )
+    {
+        write_cr4(cr4 | X86_CR4_OSXSAVE);
+        write_xcr0(mask);
+    }
+    else
+        write_cr4(cr4);
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -40,6 +40,11 @@ COMMON_CFLAGS += -fno-stack-protector -fno-pic -ffreestanding
 COMMON_CFLAGS += -mno-red-zone -mno-sse
 COMMON_CFLAGS += -Wno-unused-parameter -Winline
 
+# Objects listed in a test's obj-simd may contain vector code, up to SSE2.
+# Wider code must be confined to functions with a target() attribute.  The
+# test must enable the state (see arch/xstate.h) before calling into them.
+SIMD_CFLAGS := -msse -msse2
+
 COMMON_AFLAGS-x86_32 := -m32
 COMMON_AFLAGS-x86_64 := -m64
 
@@ -51,6 +56,7 @@ defcfg-hvm   := $(ROOT)/config/default-hvm.cfg.in
 
 obj-perbits :=
 obj-perenv  :=
+obj-simd    :=
 include $(ROOT)/build/files.mk
 
 # Run once per environment to set up some common bits & pieces
@@ -69,7 +75,8 @@ LDFLAGS_$(1) := -T $$(link-$(1)) -nostdlib $(LDFLAGS-y)
 # Needs to pick up test-provided obj-perenv and obj-perbits
 DEPS-$(1) = \
 	$$(obj-perbits:%.o=%-$($(1)_arch).o) \
-	$$(obj-$(1):%.o=%-$(1).o) $$(obj-perenv:%.o=%-$(1).o)
+	$$(obj-$(1):%.o=%-$(1).o) $$(obj-perenv:%.o=%-$(1).o) \
+	$$(obj-simd:%.o=%-$(1).o)
 
 # Generate .lds with appropriate flags
 %/link-$(1).lds: $(ROOT)/common/link.lds.S
@@ -5,6 +5,7 @@
 # obj-$(env)   are objects unique to a specific environment
 
 obj-perbits += $(ROOT)/common/console.o
+obj-perbits += $(ROOT)/common/evtchn.o
 obj-perbits += $(ROOT)/common/extable.o
 obj-perbits += $(ROOT)/common/grant_table.o
 obj-perbits += $(ROOT)/common/heapsort.o
@@ -12,17 +13,21 @@ obj-perbits += $(ROOT)/common/lib.o
 obj-perbits += $(ROOT)/common/libc/stdio.o
 obj-perbits += $(ROOT)/common/libc/string.o
 obj-perbits += $(ROOT)/common/libc/vsnprintf.o
+obj-perbits += $(ROOT)/common/multicall.o
 obj-perbits += $(ROOT)/common/report.o
 obj-perbits += $(ROOT)/common/setup.o
+obj-perbits += $(ROOT)/common/timer.o
 obj-perbits += $(ROOT)/common/xenbus.o
 obj-perbits += $(ROOT)/common/weak-defaults.o
 
 obj-perenv += $(ROOT)/arch/x86/decode.o
 obj-perenv += $(ROOT)/arch/x86/desc.o
+obj-perenv += $(ROOT)/arch/x86/evtchn.o
 obj-perenv += $(ROOT)/arch/x86/extable.o
 obj-perenv += $(ROOT)/arch/x86/grant_table.o
 obj-perenv += $(ROOT)/arch/x86/hypercall_page.o
 obj-perenv += $(ROOT)/arch/x86/msr.o
+obj-perenv += $(ROOT)/arch/x86/pmu.o
 obj-perenv += $(ROOT)/arch/x86/setup.o
 obj-perenv += $(ROOT)/arch/x86/traps.o
 
@@ -36,14 +41,17 @@ obj-hvm += $(ROOT)/arch/x86/hvm/traps.o
 obj-hvm += $(ROOT)/arch/x86/io-apic.o
 
 # Arguably common objects, but PV guests will have no interest in them.
+obj-hvm += $(ROOT)/arch/x86/svm.o
 obj-hvm += $(ROOT)/arch/x86/vmx.o
 obj-hvm += $(ROOT)/arch/x86/x86-tss.o
+obj-hvm += $(ROOT)/arch/x86/xstate.o
 
 $(foreach env,$(HVM_ENVIRONMENTS),$(eval obj-$(env) += $(obj-hvm)))
 
 
 # PV specific objects
 obj-pv  += $(ROOT)/arch/x86/pv/head.o
+obj-pv  += $(ROOT)/arch/x86/pv/mmu-batch.o
 obj-pv  += $(ROOT)/arch/x86/pv/traps.o
 $(foreach env,$(PV_ENVIRONMENTS),$(eval obj-$(env) += $(obj-pv)))
 
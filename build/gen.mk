@@ -47,18 +47,24 @@ hvm64-format := $(firstword $(filter elf32-x86-64,$(shell $(OBJCOPY) --help)) el
 
 define PERENV_build
 
+# The exception table is sorted at build time.  See build/sort-extable.py
 ifneq ($(1),hvm64)
 # Generic link line for most environments
-test-$(1)-$(NAME): $$(DEPS-$(1)) $$(link-$(1))
+test-$(1)-$(NAME): $$(DEPS-$(1)) $$(link-$(1)) $(ROOT)/build/sort-extable.py
 	$(LD) $$(LDFLAGS_$(1)) $$(DEPS-$(1)) -o $$@
+	$(PYTHON) $(ROOT)/build/sort-extable.py $$@
 else
 # hvm64 needs linking normally, then converting to elf32-x86-64 or elf32-i386
-test-$(1)-$(NAME): $$(DEPS-$(1)) $$(link-$(1))
+test-$(1)-$(NAME): $$(DEPS-$(1)) $$(link-$(1)) $(ROOT)/build/sort-extable.py
 	$(LD) $$(LDFLAGS_$(1)) $$(DEPS-$(1)) -o $$@.tmp
+	$(PYTHON) $(ROOT)/build/sort-extable.py $$@.tmp
 	$(OBJCOPY) $$@.tmp -O $(hvm64-format) $$@
 	rm -f $$@.tmp
 endif
 
+# Vector code is permitted in obj-simd.  See SIMD_CFLAGS
+$$(obj-simd:%.o=%-$(1).o): CFLAGS_$(1) += $(SIMD_CFLAGS)
+
 cfg-$(1) ?= $(defcfg-$($(1)_guest))
 
 cfg-default-deps := $(ROOT)/build/mkcfg.py $$(cfg-$(1)) $(TEST-EXTRA-CFG) Makefile
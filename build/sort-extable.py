@@ -0,0 +1,115 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+import struct
+import sys
+
+# Usage: sort-extable.py $ELF
+#
+# Sort the exception table (__start_ex_table to __stop_ex_table) of a linked
+# ELF image in place, by fault address, then re-read the image to check the
+# result.  Entries are struct extable_entry, three words of the ELF class's
+# size.
+
+_, path = sys.argv
+
+def fail(msg):
+    sys.stderr.write("%s: %s\n" % (path, msg))
+    sys.exit(1)
+
+data = bytearray(open(path, "rb").read())
+
+if data[:4] != b"\x7fELF" or data[5] != 1:
+    fail("Not a little endian ELF image")
+
+if data[4] == 1:
+    word = "I"
+    shoff, = struct.unpack_from("<I", data, 0x20)
+    shentsize, shnum = struct.unpack_from("<HH", data, 0x2e)
+    shdr_fmt, sym_fmt = "<IIIIIIIIII", "<IIIBBH"
+elif data[4] == 2:
+    word = "Q"
+    shoff, = struct.unpack_from("<Q", data, 0x28)
+    shentsize, shnum = struct.unpack_from("<HH", data, 0x3a)
+    shdr_fmt, sym_fmt = "<IIQQQQIIQQ", "<IBBHQQ"
+else:
+    fail("Unknown ELF class %d" % data[4])
+
+SHT_SYMTAB, SHT_NOBITS = 2, 8
+
+# (type, addr, offset, size, link, entsize) of each section.
+sections = []
+for i in range(shnum):
+    s = struct.unpack_from(shdr_fmt, data, shoff + i * shentsize)
+    sections.append((s[1], s[3], s[4], s[5], s[6], s[9]))
+
+def sym_value(sym):
+    return sym[1] if word == "I" else sym[4]
+
+def find_symbols(names):
+    found = {}
+
+    for typ, _, offset, size, link, entsize in sections:
+        if typ != SHT_SYMTAB:
+            continue
+
+        stroff = sections[link][2]
+
+        for off in range(offset, offset + size, entsize):
+            sym = struct.unpack_from(sym_fmt, data, off)
+            end = data.index(b"\0", stroff + sym[0])
+            name = bytes(data[stroff + sym[0]:end]).decode()
+
+            if name in names:
+                found[name] = sym_value(sym)
+
+    for name in names:
+        if name not in found:
+            fail("No symbol %s" % name)
+
+    return [found[name] for name in names]
+
+def file_offset(addr):
+    for typ, saddr, offset, size, _, _ in sections:
+        if typ != SHT_NOBITS and saddr <= addr < saddr + size:
+            return offset + addr - saddr
+
+    fail("Address %#x not in the image" % addr)
+
+start, stop = find_symbols(["__start_ex_table", "__stop_ex_table"])
+
+entry_fmt = "<3" + word
+entry_size = struct.calcsize(entry_fmt)
+nr = (stop - start) // entry_size
+
+if (stop - start) % entry_size:
+    fail("Exception table size %#x not a multiple of %d" %
+         (stop - start, entry_size))
+
+if nr == 0:
+    sys.exit(0)
+
+base = file_offset(start)
+entries = [struct.unpack_from(entry_fmt, data, base + i * entry_size)
+           for i in range(nr)]
+
+# Stable, so entries with equal fault addresses keep their link order.
+entries.sort(key=lambda e: e[0])
+
+for i, e in enumerate(entries):
+    struct.pack_into(entry_fmt, data, base + i * entry_size, *e)
+
+with open(path, "wb") as f:
+    f.write(data)
+
+# Check what actually landed in the image, rather than the list just sorted:
+# the same entries, in fault address order.
+data = open(path, "rb").read()
+written = [struct.unpack_from(entry_fmt, data, base + i * entry_size)
+           for i in range(nr)]
+
+if sorted(written) != sorted(entries):
+    fail("Exception table contents changed while sorting")
+
+for i in range(1, nr):
+    if written[i - 1][0] > written[i][0]:
+        fail("Exception table not sorted at entry %d" % i)
@@ -2,6 +2,7 @@
 #include <xtf/atomic.h>
 #include <xtf/bitops.h>
 #include <xtf/console.h>
+#include <xtf/evtchn.h>
 #include <xtf/hypercall.h>
 #include <xtf/lib.h>
 #include <xtf/libc.h>
@@ -57,9 +58,10 @@ size_t pv_console_read_some(char *buf, size_t len)
     size_t s = 0;
     uint32_t cons, prod;
 
-    while ( !test_and_clear_bit(pv_evtchn, shared_info.evtchn_pending) ||
-            (pv_ring->in_cons == pv_ring->in_prod) )
-        hypercall_poll(pv_evtchn);
+    do
+    {
+        evtchn_poll(pv_evtchn);
+    } while ( pv_ring->in_cons == pv_ring->in_prod );
 
     cons = pv_ring->in_cons;
     prod = LOAD_ACQUIRE(&pv_ring->in_prod);
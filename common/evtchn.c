@@ -0,0 +1,402 @@
+/**
+ * @file common/evtchn.c
+ *
+ * Event channel handling.
+ *
+ * The 2-level ABI is used from boot.  The FIFO ABI may be switched to with
+ * evtchn_init_fifo(), after which the 2-level bitmaps in shared_info are no
+ * longer used by Xen.
+ */
+#include <xtf/atomic.h>
+#include <xtf/bitops.h>
+#include <xtf/evtchn.h>
+#include <xtf/lib.h>
+#include <xtf/traps.h>
+
+#include <arch/mm.h>
+
+static struct evtchn_action {
+    evtchn_handler_t fn;
+    void *data;
+} actions[EVTCHN_NR_PORTS];
+
+static bool evtchn_ready;
+
+/* Operations which differ between the 2-level and FIFO ABIs. */
+struct evtchn_port_ops {
+    enum evtchn_abi abi;
+    void (*mask)(evtchn_port_t port);
+    bool (*test_and_clear_pending)(evtchn_port_t port);
+    void (*handle_upcall)(struct vcpu_info *vcpu);
+};
+
+static void dispatch(evtchn_port_t port)
+{
+    if ( port < ARRAY_SIZE(actions) && actions[port].fn )
+        actions[port].fn(port, actions[port].data);
+}
+
+/*
+ * 2-level ABI.  Pending and mask bitmaps live in shared_info, with a per-vCPU
+ * selector word indicating which words of evtchn_pending[] to scan.
+ */
+static void evtchn_2l_mask(evtchn_port_t port)
+{
+    if ( port < EVTCHN_2L_NR_PORTS )
+        test_and_set_bit(port, shared_info.evtchn_mask);
+}
+
+static bool evtchn_2l_test_and_clear_pending(evtchn_port_t port)
+{
+    return (port < EVTCHN_2L_NR_PORTS &&
+            test_and_clear_bit(port, shared_info.evtchn_pending));
+}
+
+static void evtchn_2l_handle_upcall(struct vcpu_info *vcpu)
+{
+    do
+    {
+        unsigned long sel;
+
+        /* Clear pending before consuming the selector, to avoid races. */
+        ACCESS_ONCE(vcpu->evtchn_upcall_pending) = 0;
+        sel = xchg(&vcpu->evtchn_pending_sel, 0);
+
+        while ( sel )
+        {
+            unsigned int word = __builtin_ctzl(sel);
+            unsigned long pending =
+                ACCESS_ONCE(shared_info.evtchn_pending[word]) &
+                ~ACCESS_ONCE(shared_info.evtchn_mask[word]);
+
+            sel &= sel - 1;
+
+            while ( pending )
+            {
+                evtchn_port_t port =
+                    word * BITS_PER_LONG + __builtin_ctzl(pending);
+
+                pending &= pending - 1;
+
+                if ( test_and_clear_bit(port, shared_info.evtchn_pending) )
+                    dispatch(port);
+            }
+        }
+    } while ( ACCESS_ONCE(vcpu->evtchn_upcall_pending) );
+}
+
+static const struct evtchn_port_ops evtchn_2l_ops = {
+    .abi                    = EVTCHN_ABI_2L,
+    .mask                   = evtchn_2l_mask,
+    .test_and_clear_pending = evtchn_2l_test_and_clear_pending,
+    .handle_upcall          = evtchn_2l_handle_upcall,
+};
+
+/*
+ * FIFO ABI.  Each port has an event word in the event array.  Xen links
+ * pending events onto one of 16 priority queues, indicated by the ready bits
+ * and queue heads in the per-vCPU control block.
+ */
+static event_word_t fifo_array[EVTCHN_NR_PORTS] __page_aligned_bss;
+static uint8_t fifo_control_page[PAGE_SIZE] __page_aligned_bss;
+static evtchn_fifo_control_block_t *const fifo_control =
+    (void *)fifo_control_page;
+
+/* Our position in each queue.  0 means "reread the head from Xen". */
+static evtchn_port_t fifo_head[EVTCHN_FIFO_MAX_QUEUES];
+
+static void evtchn_fifo_mask(evtchn_port_t port)
+{
+    if ( port < ARRAY_SIZE(fifo_array) )
+        __atomic_fetch_or(&fifo_array[port], 1u << EVTCHN_FIFO_MASKED,
+                          __ATOMIC_SEQ_CST);
+}
+
+static bool evtchn_fifo_test_and_clear_pending(evtchn_port_t port)
+{
+    return (port < ARRAY_SIZE(fifo_array) &&
+            (__atomic_fetch_and(&fifo_array[port],
+                                ~(1u << EVTCHN_FIFO_PENDING),
+                                __ATOMIC_SEQ_CST) &
+             (1u << EVTCHN_FIFO_PENDING)));
+}
+
+/* Consume the event at the head of queue @p q. */
+static void evtchn_fifo_consume_one(unsigned int q, uint32_t *ready)
+{
+    evtchn_port_t port = fifo_head[q];
+    event_word_t *word, w;
+
+    if ( !port )
+    {
+        smp_rmb();
+        port = ACCESS_ONCE(fifo_control->head[q]);
+    }
+
+    if ( port >= ARRAY_SIZE(fifo_array) )
+        panic("FIFO evtchn %u beyond event array\n", port);
+
+    word = &fifo_array[port];
+
+    /* Unlink the event, retrieving the next one in the queue. */
+    do {
+        w = ACCESS_ONCE(*word);
+    } while ( cmpxchg(word, w, w & ~((1u << EVTCHN_FIFO_LINKED) |
+                                      EVTCHN_FIFO_LINK_MASK)) != w );
+
+    fifo_head[q] = w & EVTCHN_FIFO_LINK_MASK;
+
+    /* End of the queue. */
+    if ( !fifo_head[q] )
+        *ready &= ~(1u << q);
+
+    if ( !(w & (1u << EVTCHN_FIFO_MASKED)) &&
+         evtchn_fifo_test_and_clear_pending(port) )
+        dispatch(port);
+}
+
+static void evtchn_fifo_handle_upcall(struct vcpu_info *vcpu)
+{
+    uint32_t ready;
+
+    ACCESS_ONCE(vcpu->evtchn_upcall_pending) = 0;
+    ready = xchg(&fifo_control->ready, 0);
+
+    while ( ready )
+    {
+        /* Lowest numbered queue is highest priority. */
+        evtchn_fifo_consume_one(__builtin_ctz(ready), &ready);
+
+        ready |= xchg(&fifo_control->ready, 0);
+    }
+}
+
+static const struct evtchn_port_ops evtchn_fifo_ops = {
+    .abi                    = EVTCHN_ABI_FIFO,
+    .mask                   = evtchn_fifo_mask,
+    .test_and_clear_pending = evtchn_fifo_test_and_clear_pending,
+    .handle_upcall          = evtchn_fifo_handle_upcall,
+};
+
+static const struct evtchn_port_ops *ops = &evtchn_2l_ops;
+
+enum evtchn_abi evtchn_abi(void)
+{
+    return ops->abi;
+}
+
+int evtchn_init(void)
+{
+    int rc;
+
+    BUILD_BUG_ON(EVTCHN_2L_NR_PORTS !=
+                 sizeof(shared_info.evtchn_pending) * CHAR_BIT);
+
+    if ( evtchn_ready )
+        return 0;
+
+    /* Mask everything.  Ports are unmasked as handlers are registered. */
+    memset(shared_info.evtchn_mask, 0xff, sizeof(shared_info.evtchn_mask));
+
+    rc = arch_init_evtchn();
+    if ( rc )
+        return rc;
+
+    evtchn_ready = true;
+
+    return 0;
+}
+
+int evtchn_init_fifo(void)
+{
+    struct evtchn_init_control init = {
+        .control_gfn = virt_to_gfn(fifo_control_page),
+        .offset = 0,
+        .vcpu = 0,
+    };
+    unsigned int i;
+    int rc;
+
+    BUILD_BUG_ON(sizeof(fifo_array) % PAGE_SIZE);
+
+    if ( ops == &evtchn_fifo_ops )
+        return 0;
+
+    rc = evtchn_init();
+    if ( rc )
+        return rc;
+
+    /* Mask everything.  Ports are unmasked as handlers are registered. */
+    for ( i = 0; i < ARRAY_SIZE(fifo_array); ++i )
+        fifo_array[i] = 1u << EVTCHN_FIFO_MASKED;
+
+    rc = hypercall_event_channel_op(EVTCHNOP_init_control, &init);
+    if ( rc )
+        return rc;
+
+    /*
+     * Xen has switched ABI, and there is no way back without closing every
+     * port.  Failure from here on is fatal.
+     */
+    ops = &evtchn_fifo_ops;
+
+    for ( i = 0; i < sizeof(fifo_array) / PAGE_SIZE; ++i )
+    {
+        struct evtchn_expand_array expand = {
+            .array_gfn = virt_to_gfn(&fifo_array[i * (PAGE_SIZE /
+                                                      sizeof(event_word_t))]),
+        };
+
+        rc = hypercall_event_channel_op(EVTCHNOP_expand_array, &expand);
+        if ( rc )
+            panic("Failed to expand FIFO event array[%u]: %d\n", i, rc);
+    }
+
+    /* Ports with handlers were unmasked under the 2-level ABI. */
+    for ( i = 0; i < ARRAY_SIZE(actions); ++i )
+        if ( actions[i].fn )
+            evtchn_unmask(i);
+
+    return 0;
+}
+
+int evtchn_alloc_unbound(domid_t remote, evtchn_port_t *port)
+{
+    struct evtchn_alloc_unbound op = {
+        .dom = DOMID_SELF,
+        .remote_dom = remote,
+    };
+    int rc = hypercall_event_channel_op(EVTCHNOP_alloc_unbound, &op);
+
+    if ( !rc )
+    {
+        evtchn_mask(op.port);
+        *port = op.port;
+    }
+
+    return rc;
+}
+
+int evtchn_bind_interdomain(domid_t remote, evtchn_port_t remote_port,
+                            evtchn_port_t *port)
+{
+    struct evtchn_bind_interdomain op = {
+        .remote_dom = remote,
+        .remote_port = remote_port,
+    };
+    int rc = hypercall_event_channel_op(EVTCHNOP_bind_interdomain, &op);
+
+    if ( !rc )
+    {
+        evtchn_mask(op.local_port);
+        *port = op.local_port;
+    }
+
+    return rc;
+}
+
+int evtchn_bind_ipi(unsigned int vcpu, evtchn_port_t *port)
+{
+    struct evtchn_bind_ipi op = {
+        .vcpu = vcpu,
+    };
+    int rc = hypercall_event_channel_op(EVTCHNOP_bind_ipi, &op);
+
+    if ( !rc )
+    {
+        evtchn_mask(op.port);
+        *port = op.port;
+    }
+
+    return rc;
+}
+
+int evtchn_bind_virq(unsigned int virq, unsigned int vcpu,
+                     evtchn_port_t *port)
+{
+    struct evtchn_bind_virq op = {
+        .virq = virq,
+        .vcpu = vcpu,
+    };
+    int rc = hypercall_event_channel_op(EVTCHNOP_bind_virq, &op);
+
+    if ( !rc )
+    {
+        evtchn_mask(op.port);
+        *port = op.port;
+    }
+
+    return rc;
+}
+
+int evtchn_close(evtchn_port_t port)
+{
+    struct evtchn_close op = {
+        .port = port,
+    };
+
+    evtchn_set_handler(port, NULL, NULL);
+
+    return hypercall_event_channel_op(EVTCHNOP_close, &op);
+}
+
+void evtchn_set_handler(evtchn_port_t port, evtchn_handler_t fn, void *data)
+{
+    if ( port >= ARRAY_SIZE(actions) )
+        panic("evtchn %u out of range\n", port);
+
+    evtchn_mask(port);
+
+    actions[port].fn = fn;
+    actions[port].data = data;
+
+    if ( fn )
+        evtchn_unmask(port);
+}
+
+void evtchn_mask(evtchn_port_t port)
+{
+    ops->mask(port);
+}
+
+int evtchn_unmask(evtchn_port_t port)
+{
+    struct evtchn_unmask op = {
+        .port = port,
+    };
+
+    return hypercall_event_channel_op(EVTCHNOP_unmask, &op);
+}
+
+bool evtchn_test_and_clear_pending(evtchn_port_t port)
+{
+    return ops->test_and_clear_pending(port);
+}
+
+void evtchn_poll(evtchn_port_t port)
+{
+    while ( !evtchn_test_and_clear_pending(port) )
+        hypercall_poll(port);
+}
+
+/*
+ * Upcall handler.  Dispatches each pending unmasked port to its handler.
+ * Weak, so tests may take over event handling entirely.
+ */
+void __weak do_evtchn(struct cpu_regs *regs)
+{
+    if ( !evtchn_ready )
+        panic("Unhandled evtchn upcall\n");
+
+    ops->handle_upcall(&shared_info.vcpu_info[0]);
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
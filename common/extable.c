@@ -2,18 +2,52 @@
  * @file common/extable.c
  *
  * Exception table support.
+ *
+ * The build sorts the table in the linked image (build/sort-extable.py), so
+ * sort_extable() normally only has to confirm the order.  For large tables,
+ * a coarse index over the fault addresses narrows each search to a single
+ * bucket.
  */
 #include <xtf/lib.h>
 #include <xtf/extable.h>
 
 extern struct extable_entry __start_ex_table[], __stop_ex_table[];
 
+/* Tables smaller than this are searched without the index. */
+#define INDEX_MIN     64
+#define INDEX_BUCKETS 256
+
+/*
+ * Bucket b covers fault addresses from base + (b << shift), up to the start
+ * of bucket b + 1, and its entries are [index[b], index[b + 1]).
+ */
+static unsigned int extable_index[INDEX_BUCKETS + 1];
+static unsigned long extable_base;
+static unsigned int extable_shift;
+static bool extable_indexed;
+
 const struct extable_entry *search_extable(unsigned long addr)
 {
     const struct extable_entry *start = __start_ex_table,
         *stop = __stop_ex_table, *mid;
 
-    while ( start <= stop )
+    if ( extable_indexed )
+    {
+        unsigned long bucket;
+
+        if ( addr < extable_base )
+            return NULL;
+
+        bucket = (addr - extable_base) >> extable_shift;
+        if ( bucket >= INDEX_BUCKETS )
+            return NULL;
+
+        start = __start_ex_table + extable_index[bucket];
+        stop  = __start_ex_table + extable_index[bucket + 1];
+    }
+
+    /* Search [start, stop). */
+    while ( start < stop )
     {
         mid = start + (stop - start) / 2;
 
@@ -22,10 +56,10 @@ const struct extable_entry *search_extable(unsigned long addr)
         else if ( addr > mid->fault )
             start = mid + 1;
         else
-            stop = mid - 1;
+            stop = mid;
     }
 
-    return 0;
+    return NULL;
 }
 
 static int compare_extable_entry(const void *_l, const void *_r)
@@ -49,13 +83,58 @@ static void swap_extable_entry(void *_l, void *_r)
     *r = tmp;
 }
 
+static bool extable_is_sorted(void)
+{
+    unsigned int nr = __stop_ex_table - __start_ex_table;
+
+    for ( unsigned int i = 1; i < nr; ++i )
+        if ( __start_ex_table[i - 1].fault > __start_ex_table[i].fault )
+            return false;
+
+    return true;
+}
+
+static void build_index(void)
+{
+    unsigned int nr = __stop_ex_table - __start_ex_table, i = 0;
+    unsigned long span;
+
+    if ( nr < INDEX_MIN )
+        return;
+
+    extable_base = __start_ex_table[0].fault;
+    span = __start_ex_table[nr - 1].fault - extable_base;
+
+    extable_shift = 0;
+    while ( (span >> extable_shift) >= INDEX_BUCKETS )
+        extable_shift++;
+
+    for ( unsigned int b = 0; b < INDEX_BUCKETS; ++b )
+    {
+        unsigned long bucket_start =
+            extable_base + ((unsigned long)b << extable_shift);
+
+        while ( i < nr && __start_ex_table[i].fault < bucket_start )
+            i++;
+
+        extable_index[b] = i;
+    }
+    extable_index[INDEX_BUCKETS] = nr;
+
+    extable_indexed = true;
+}
+
 void sort_extable(void)
 {
-    heapsort(__start_ex_table,
-             __stop_ex_table - __start_ex_table,
-             sizeof(__start_ex_table[0]),
-             compare_extable_entry,
-             swap_extable_entry);
+    /* Fallback, for images which haven't been sorted by the build. */
+    if ( !extable_is_sorted() )
+        heapsort(__start_ex_table,
+                 __stop_ex_table - __start_ex_table,
+                 sizeof(__start_ex_table[0]),
+                 compare_extable_entry,
+                 swap_extable_entry);
+
+    build_index();
 }
 
 /*
@@ -3,6 +3,7 @@
  *
  * A driver for the Xen Grant Table interface.
  */
+#include <xtf/atomic.h>
 #include <xtf/grant_table.h>
 #include <xtf/lib.h>
 
@@ -10,6 +11,31 @@ uint8_t gnttab_raw[] __page_aligned_bss;
 extern grant_entry_v1_t gnttab_v1[] __alias("gnttab_raw");
 extern grant_entry_v2_t gnttab_v2[] __alias("gnttab_raw");
 
+unsigned int gnttab_nr_frames;
+static unsigned int gnttab_version;
+
+/*
+ * Free list of grant references, linked through free_next[].  Reference 0 is
+ * reserved so never free, and terminates the list.
+ */
+static uint16_t free_next[ARRAY_SIZE(gnttab_v1)];
+static grant_ref_t free_head;
+
+static unsigned int entries_per_frame(void)
+{
+    return gnttab_version == 2 ? PAGE_SIZE / sizeof(grant_entry_v2_t)
+                               : PAGE_SIZE / sizeof(grant_entry_v1_t);
+}
+
+/* Free references [@p start, @p end), such that they allocate in order. */
+static void free_refs(grant_ref_t start, grant_ref_t end)
+{
+    start = max(start, (grant_ref_t)GNTTAB_NR_RESERVED_ENTRIES);
+
+    while ( end-- > start )
+        gnttab_free_ref(end);
+}
+
 const char *gntst_strerror(int err)
 {
     static const char *const errstr[] = GNTTABOP_error_msgs;
@@ -44,15 +70,156 @@ int xtf_init_grant_table(unsigned int version)
         /* Sufficiently old Xen which only knows about gnttab v1. */
         return -ENODEV;
 
-    static bool gnttab_mapped;
-    if ( !gnttab_mapped )
+    if ( !gnttab_nr_frames )
+    {
+        rc = arch_map_gnttab(0, 1);
+
+        if ( rc )
+            return rc;
+
+        gnttab_nr_frames = 1;
+    }
+
+    gnttab_version = version;
+
+    free_head = 0;
+    free_refs(0, gnttab_nr_frames * entries_per_frame());
+
+    return 0;
+}
+
+int gnttab_grow(unsigned int nr_frames)
+{
+    unsigned int old = gnttab_nr_frames;
+    int rc;
+
+    if ( nr_frames <= old )
+        return 0;
+
+    if ( nr_frames > GNTTAB_MAX_FRAMES )
+        return -E2BIG;
+
+    if ( !gnttab_version )
+        return -ENODEV;
+
+    rc = arch_map_gnttab(old, nr_frames - old);
+    if ( rc )
+        return rc;
+
+    gnttab_nr_frames = nr_frames;
+    free_refs(old * entries_per_frame(), nr_frames * entries_per_frame());
+
+    return 0;
+}
+
+int gnttab_alloc_ref(grant_ref_t *ref)
+{
+    if ( !free_head )
+    {
+        int rc = gnttab_grow(gnttab_nr_frames + 1);
+
+        if ( rc )
+            return rc;
+    }
+
+    *ref = free_head;
+    free_head = free_next[free_head];
+
+    return 0;
+}
+
+void gnttab_free_ref(grant_ref_t ref)
+{
+    ASSERT(ref >= GNTTAB_NR_RESERVED_ENTRIES && ref < ARRAY_SIZE(free_next));
+
+    free_next[ref] = free_head;
+    free_head = ref;
+}
+
+int gnttab_grant_access(domid_t domid, unsigned long gfn, bool readonly,
+                        grant_ref_t *ref)
+{
+    uint16_t flags = GTF_permit_access | (readonly ? GTF_readonly : 0);
+    int rc = gnttab_alloc_ref(ref);
+
+    if ( rc )
+        return rc;
+
+    if ( gnttab_version == 2 )
     {
-        rc = arch_map_gnttab();
+        grant_entry_v2_t *e = &gnttab_v2[*ref];
+
+        e->full_page.frame = gfn;
+        e->hdr.domid = domid;
+        smp_wmb();
+        ACCESS_ONCE(e->hdr.flags) = flags;
+    }
+    else
+    {
+        grant_entry_v1_t *e = &gnttab_v1[*ref];
+
+        e->frame = gfn;
+        e->domid = domid;
+        smp_wmb();
+        ACCESS_ONCE(e->flags) = flags;
+    }
+
+    return 0;
+}
+
+int gnttab_end_access(grant_ref_t ref)
+{
+    if ( gnttab_version == 2 )
+        ACCESS_ONCE(gnttab_v2[ref].hdr.flags) = GTF_invalid;
+    else
+    {
+        grant_entry_v1_t *e = &gnttab_v1[ref];
+        uint16_t flags;
+
+        /* Xen sets GTF_{reading,writing} while the grant is mapped. */
+        do {
+            flags = ACCESS_ONCE(e->flags);
 
-        if ( !rc )
-            gnttab_mapped = true;
+            if ( flags & (GTF_reading | GTF_writing) )
+                return -EBUSY;
+        } while ( cmpxchg(&e->flags, flags, GTF_invalid) != flags );
     }
 
+    gnttab_free_ref(ref);
+
+    return 0;
+}
+
+int gnttab_batch_map(struct gnttab_map_grant_ref *ops, unsigned int nr)
+{
+    int rc = hypercall_grant_table_op(GNTTABOP_map_grant_ref, ops, nr);
+
+    for ( unsigned int i = 0; !rc && i < nr; ++i )
+        if ( ops[i].status != GNTST_okay )
+            rc = -EIO;
+
+    return rc;
+}
+
+int gnttab_batch_unmap(struct gnttab_unmap_grant_ref *ops, unsigned int nr)
+{
+    int rc = hypercall_grant_table_op(GNTTABOP_unmap_grant_ref, ops, nr);
+
+    for ( unsigned int i = 0; !rc && i < nr; ++i )
+        if ( ops[i].status != GNTST_okay )
+            rc = -EIO;
+
+    return rc;
+}
+
+int gnttab_batch_copy(struct gnttab_copy *ops, unsigned int nr)
+{
+    int rc = hypercall_grant_table_op(GNTTABOP_copy, ops, nr);
+
+    for ( unsigned int i = 0; !rc && i < nr; ++i )
+        if ( ops[i].status != GNTST_okay )
+            rc = -EIO;
+
     return rc;
 }
 
@@ -0,0 +1,90 @@
+/**
+ * @file common/multicall.c
+ *
+ * Builder for batches of hypercalls, issued with `HYPERVISOR_multicall`.
+ */
+#include <xtf/lib.h>
+#include <xtf/multicall.h>
+
+void mc_begin(struct mc_batch *mc, multicall_entry_t *ents, unsigned int size)
+{
+    ASSERT(size);
+
+    mc->ents = ents;
+    mc->size = size;
+    mc->nr = 0;
+    mc->issued = 0;
+    mc->failed = 0;
+    mc->rc = 0;
+}
+
+static void mc_issue(struct mc_batch *mc)
+{
+    unsigned int nr = mc->nr;
+    long rc;
+
+    if ( !nr )
+        return;
+
+    rc = hypercall_multicall(mc->ents, nr);
+
+    if ( !mc->rc )
+    {
+        if ( rc )
+        {
+            /* The multicall as a whole failed.  Blame its first entry. */
+            mc->rc = rc;
+            mc->failed = mc->issued;
+        }
+        else
+        {
+            /*
+             * Some calls (xen_version, memory_op's extent counts, etc)
+             * return positive values on success.  Only negative results
+             * are errors.
+             */
+            for ( unsigned int i = 0; i < nr; ++i )
+            {
+                if ( (long)mc->ents[i].result < 0 )
+                {
+                    mc->rc = (long)mc->ents[i].result;
+                    mc->failed = mc->issued + i;
+                    break;
+                }
+            }
+        }
+    }
+
+    mc->issued += nr;
+    mc->nr = 0;
+}
+
+multicall_entry_t *mc_add(struct mc_batch *mc, unsigned long op)
+{
+    multicall_entry_t *e;
+
+    if ( mc->nr == mc->size )
+        mc_issue(mc);
+
+    e = &mc->ents[mc->nr++];
+    *e = (multicall_entry_t){ .op = op };
+
+    return e;
+}
+
+long mc_flush(struct mc_batch *mc)
+{
+    mc_issue(mc);
+
+    return mc->rc;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
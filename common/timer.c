@@ -0,0 +1,286 @@
+/**
+ * @file common/timer.c
+ *
+ * Timers, driven by Xen's per-vCPU single-shot timer.
+ *
+ * The list of armed timers is shared with the `VIRQ_TIMER` handler, so is
+ * only modified with upcalls disabled.
+ */
+#include <xtf/atomic.h>
+#include <xtf/barrier.h>
+#include <xtf/evtchn.h>
+#include <xtf/hypercall.h>
+#include <xtf/lib.h>
+#include <xtf/timer.h>
+#include <xtf/traps.h>
+
+#include <arch/lib.h>
+
+static struct timer *head;
+static evtchn_port_t timer_port;
+static bool timer_ready, use_set_timer_op;
+
+/* Scale a TSC delta to ns, avoiding a 64x64 multiply overflowing. */
+static uint64_t scale_delta(uint64_t delta, uint32_t mul, int8_t shift)
+{
+    if ( shift < 0 )
+        delta >>= -shift;
+    else
+        delta <<= shift;
+
+    return (((delta & 0xffffffff) * mul) >> 32) + (delta >> 32) * mul;
+}
+
+uint64_t xen_system_time(void)
+{
+    const struct vcpu_time_info *t = &shared_info.vcpu_info[0].time;
+    uint32_t version;
+    uint64_t now;
+
+    do {
+        version = ACCESS_ONCE(t->version);
+        smp_rmb();
+
+        now = t->system_time +
+            scale_delta(rdtsc() - t->tsc_timestamp,
+                        t->tsc_to_system_mul, t->tsc_shift);
+
+        smp_rmb();
+    } while ( (version & 1) || version != ACCESS_ONCE(t->version) );
+
+    return now;
+}
+
+/* Program Xen's single-shot timer for the earliest deadline. */
+static void program(void)
+{
+    uint64_t deadline = head ? head->deadline : 0;
+    int rc;
+
+    if ( use_set_timer_op )
+        rc = hypercall_set_timer_op(deadline);
+    else if ( head )
+    {
+        struct vcpu_set_singleshot_timer op = {
+            .timeout_abs_ns = deadline,
+        };
+
+        rc = hypercall_vcpu_op(VCPUOP_set_singleshot_timer, 0, &op);
+    }
+    else
+        rc = hypercall_vcpu_op(VCPUOP_stop_singleshot_timer, 0, NULL);
+
+    if ( rc )
+        panic("Failed to program timer for %"PRIu64": %d\n", deadline, rc);
+}
+
+static void enqueue(struct timer *t)
+{
+    struct timer **p = &head;
+
+    /* Equal deadlines expire in the order they were armed. */
+    while ( *p && (*p)->deadline <= t->deadline )
+        p = &(*p)->next;
+
+    t->next = *p;
+    *p = t;
+    t->armed = true;
+}
+
+static void dequeue(struct timer *t)
+{
+    for ( struct timer **p = &head; *p; p = &(*p)->next )
+    {
+        if ( *p == t )
+        {
+            *p = t->next;
+            break;
+        }
+    }
+
+    t->next = NULL;
+    t->armed = false;
+}
+
+static void timer_handler(evtchn_port_t port, void *data)
+{
+    uint64_t now = xen_system_time();
+
+    while ( head && head->deadline <= now )
+    {
+        struct timer *t = head;
+
+        head = t->next;
+        t->next = NULL;
+        t->armed = false;
+
+        /* t->deadline is still the expiry being handled. */
+        if ( t->fn )
+            t->fn(t, t->data);
+
+        /* Reload, unless the handler re-armed or cancelled the timer. */
+        if ( t->period && !t->armed )
+        {
+            do {
+                t->deadline += t->period;
+            } while ( t->deadline <= now );
+
+            enqueue(t);
+        }
+
+        now = xen_system_time();
+    }
+
+    program();
+}
+
+int timer_init(void)
+{
+    int rc;
+
+    if ( timer_ready )
+        return 0;
+
+    rc = evtchn_init();
+    if ( rc )
+        return rc;
+
+    /* PV guests start with a 100Hz periodic timer, which isn't wanted. */
+    rc = hypercall_vcpu_op(VCPUOP_stop_periodic_timer, 0, NULL);
+    if ( rc && rc != -ENOSYS )
+        return rc;
+
+    rc = hypercall_vcpu_op(VCPUOP_stop_singleshot_timer, 0, NULL);
+    if ( rc == -ENOSYS )
+    {
+        use_set_timer_op = true;
+        rc = hypercall_set_timer_op(0);
+    }
+    if ( rc )
+        return rc;
+
+    rc = evtchn_bind_virq(VIRQ_TIMER, 0, &timer_port);
+    if ( rc )
+        return rc;
+
+    evtchn_set_handler(timer_port, timer_handler, NULL);
+    timer_ready = true;
+
+    return 0;
+}
+
+static void arm(struct timer *t, uint64_t deadline, uint64_t period,
+                timer_fn_t fn, void *data)
+{
+    bool upcalls;
+    int rc = timer_init();
+
+    if ( rc )
+        panic("Failed to initialise timers: %d\n", rc);
+
+    upcalls = evtchn_disable_upcalls();
+
+    if ( t->armed )
+        dequeue(t);
+
+    t->deadline = deadline;
+    t->period = period;
+    t->fn = fn;
+    t->data = data;
+
+    enqueue(t);
+
+    if ( head == t )
+        program();
+
+    if ( upcalls )
+        evtchn_enable_upcalls();
+}
+
+void timer_arm_ns(struct timer *t, uint64_t deadline,
+                  timer_fn_t fn, void *data)
+{
+    arm(t, deadline, 0, fn, data);
+}
+
+void timer_arm_periodic_ns(struct timer *t, uint64_t deadline,
+                           uint64_t period, timer_fn_t fn, void *data)
+{
+    if ( !period )
+        panic("Periodic timer with no period\n");
+
+    arm(t, deadline, period, fn, data);
+}
+
+void timer_cancel(struct timer *t)
+{
+    bool upcalls = evtchn_disable_upcalls();
+
+    t->period = 0;
+
+    if ( t->armed )
+    {
+        bool was_head = head == t;
+
+        dequeue(t);
+
+        if ( was_head )
+            program();
+    }
+
+    if ( upcalls )
+        evtchn_enable_upcalls();
+}
+
+void timer_sleep_ns(uint64_t ns)
+{
+    struct timer t = {};
+
+    timer_arm_ns(&t, xen_system_time() + ns, NULL, NULL);
+
+    for ( ;; )
+    {
+        evtchn_disable_upcalls();
+
+        /* Check with upcalls disabled, so the expiry can't be missed. */
+        if ( !timer_armed(&t) )
+            break;
+
+        evtchn_block();
+    }
+
+    evtchn_enable_upcalls();
+}
+
+bool timer_wait(const volatile bool *cond, uint64_t timeout_ns)
+{
+    struct timer t = {};
+
+    timer_arm_ns(&t, xen_system_time() + timeout_ns, NULL, NULL);
+
+    for ( ;; )
+    {
+        evtchn_disable_upcalls();
+
+        /* Check with upcalls disabled, so a wakeup can't be missed. */
+        if ( *cond || !timer_armed(&t) )
+            break;
+
+        evtchn_block();
+    }
+
+    timer_cancel(&t);
+    evtchn_enable_upcalls();
+
+    return *cond;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
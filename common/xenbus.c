@@ -1,14 +1,48 @@
 #include <xtf/atomic.h>
 #include <xtf/bitops.h>
+#include <xtf/evtchn.h>
 #include <xtf/hypercall.h>
 #include <xtf/lib.h>
 #include <xtf/traps.h>
 #include <xtf/xenbus.h>
+#include <xtf/xenstore.h>
+
+#ifndef isdigit
+/* Avoid pulling in all of ctypes just for this. */
+static int isdigit(int c)
+{
+    return c >= '0' && c <= '9';
+}
+#endif
 
 static xenbus_interface_t *xb_ring;
 static evtchn_port_t xb_port;
 static char payload[XENSTORE_PAYLOAD_MAX + 1];
 
+/* Requests awaiting a reply, in submission order. */
+static struct xenstore_req *pending, **pending_tail = &pending;
+static uint32_t next_req_id = 1;
+
+/* The reply currently being received. */
+static struct {
+    struct xenstore_msg_hdr hdr;
+    uint32_t got;               /* Bytes received, including the header. */
+    struct xenstore_req *req;   /* Request being replied to, or NULL.    */
+    char *buf;                  /* Payload destination, or NULL.         */
+    size_t size;                /* Capacity of buf.                      */
+} rx;
+
+/* Queue of watch events received but not yet collected. */
+#define NR_WATCH_EVENTS 8
+#define WATCH_EVENT_MAX 512
+static struct {
+    uint32_t len;
+    char buf[WATCH_EVENT_MAX];
+} watch_events[NR_WATCH_EVENTS];
+static unsigned int watch_prod, watch_cons;
+unsigned int xenstore_dropped_watches;
+struct xenstore_stats xenstore_stats;
+
 void init_xenbus(xenbus_interface_t *ring, evtchn_port_t port)
 {
     if ( port >= (sizeof(shared_info.evtchn_pending) * CHAR_BIT) )
@@ -18,13 +52,255 @@ void init_xenbus(xenbus_interface_t *ring, evtchn_port_t port)
     xb_port = port;
 }
 
+/* Notify xenstored, accounting the kick to @p req if non-NULL. */
+static void xenbus_kick(struct xenstore_req *req)
+{
+    hypercall_evtchn_send(xb_port);
+
+    xenstore_stats.kicks++;
+    if ( req )
+        req->kicks++;
+}
+
+/*
+ * Block until xenstored signals the event channel, having found nothing to
+ * do.  A notification which arrived since the caller last looked at the
+ * rings is consumed without blocking, so the caller re-checks them.
+ */
+static void xenbus_block(struct xenstore_req *req)
+{
+    if ( evtchn_test_and_clear_pending(xb_port) )
+        return;
+
+    hypercall_poll(xb_port);
+
+    xenstore_stats.polls++;
+    if ( req )
+        req->polls++;
+}
+
+/*
+ * Read up to @p len bytes of raw data from the xenbus ring, without waiting.
+ * A NULL @p data discards the data.  Returns the number of bytes read.
+ */
+static uint32_t xenbus_read(void *data, uint32_t len)
+{
+    uint32_t prod = ACCESS_ONCE(xb_ring->rsp_prod);
+    uint32_t cons = ACCESS_ONCE(xb_ring->rsp_cons);
+    uint32_t part = prod - cons;
+
+    /* Read the data after observing the producer index. */
+    smp_rmb();
+
+    /* Avoid overrunning the ring. */
+    part = min(part, XENBUS_RING_SIZE - mask_xenbus_idx(cons));
+
+    /* Don't read more than necessary. */
+    part = min(part, len);
+
+    if ( data )
+        memcpy(data, xb_ring->rsp + mask_xenbus_idx(cons), part);
+
+    /* Complete the data read before updating the new consumer index. */
+    smp_mb();
+
+    ACCESS_ONCE(xb_ring->rsp_cons) = cons + part;
+
+    /*
+     * xenstored only waits for response space when the ring is full, so
+     * only needs notifying if it was full before this read.  The barrier
+     * orders the rsp_cons update against re-reading rsp_prod.
+     */
+    smp_mb();
+
+    if ( part && ACCESS_ONCE(xb_ring->rsp_prod) - cons >= XENBUS_RING_SIZE )
+        xenbus_kick(NULL);
+
+    return part;
+}
+
+static const struct {
+    const char *name;
+    int err;
+} xs_errors[] = {
+    { "EINVAL",   EINVAL   },
+    { "EACCES",   EACCES   },
+    { "EEXIST",   EEXIST   },
+    { "ENOENT",   ENOENT   },
+    { "ENOMEM",   ENOMEM   },
+    { "ENOSPC",   ENOSPC   },
+    { "EIO",      EIO      },
+    { "ENOSYS",   ENOSYS   },
+    { "EBUSY",    EBUSY    },
+    { "EAGAIN",   EAGAIN   },
+    { "EISCONN",  EISCONN  },
+    { "E2BIG",    E2BIG    },
+    { "EPERM",    EPERM    },
+    { "ENOTCONN", ENOTCONN },
+    { "EQUOTA",   ENOSPC   }, /* oxenstored's quota error. */
+};
+
+/* Translate the payload of an XS_ERROR reply. */
+static int xs_error(const char *str)
+{
+    for ( unsigned int i = 0; i < ARRAY_SIZE(xs_errors); ++i )
+        if ( !strcmp(str, xs_errors[i].name) )
+            return -xs_errors[i].err;
+
+    return -EIO;
+}
+
+/* A reply header has arrived.  Find where its payload should go. */
+static void rx_start(void)
+{
+    rx.req = NULL;
+    rx.buf = NULL;
+    rx.size = 0;
+
+    if ( rx.hdr.type == XS_WATCH_EVENT )
+    {
+        if ( watch_prod - watch_cons < NR_WATCH_EVENTS &&
+             rx.hdr.len <= WATCH_EVENT_MAX )
+        {
+            rx.buf = watch_events[watch_prod % NR_WATCH_EVENTS].buf;
+            rx.size = WATCH_EVENT_MAX;
+        }
+
+        return;
+    }
+
+    for ( struct xenstore_req **p = &pending; *p; p = &(*p)->next )
+    {
+        struct xenstore_req *req = *p;
+
+        if ( req->req_id != rx.hdr.req_id )
+            continue;
+
+        *p = req->next;
+        if ( !*p )
+            pending_tail = p;
+
+        rx.req = req;
+        rx.buf = req->buf;
+        rx.size = req->size - 1; /* Space for a NUL terminator. */
+        break;
+    }
+}
+
+/* A reply has been fully received. */
+static void rx_complete(void)
+{
+    struct xenstore_req *req = rx.req;
+
+    if ( rx.hdr.type == XS_WATCH_EVENT )
+    {
+        if ( rx.buf )
+            watch_events[watch_prod++ % NR_WATCH_EVENTS].len = rx.hdr.len;
+        else
+            xenstore_dropped_watches++;
+
+        return;
+    }
+
+    /* Replies to unknown requests are discarded. */
+    if ( !req )
+        return;
+
+    req->type = rx.hdr.type;
+    req->len = min((size_t)rx.hdr.len, rx.size);
+    req->buf[req->len] = '\0';
+
+    if ( req->type == XS_ERROR )
+        req->rc = xs_error(req->buf);
+    else if ( rx.hdr.len > rx.size )
+        req->rc = -ENOBUFS;
+
+    barrier();
+    req->done = true;
+}
+
+/*
+ * Receive as much of the pending replies as is available, without waiting.
+ * Returns whether any progress was made.
+ */
+static bool xenbus_rx(void)
+{
+    bool progress = false;
+
+    for ( ;; )
+    {
+        uint32_t part;
+
+        if ( rx.got < sizeof(rx.hdr) )
+        {
+            part = xenbus_read((void *)&rx.hdr + rx.got,
+                               sizeof(rx.hdr) - rx.got);
+            if ( !part )
+                break;
+
+            progress = true;
+            rx.got += part;
+
+            if ( rx.got < sizeof(rx.hdr) )
+                continue;
+
+            rx_start();
+        }
+        else
+        {
+            uint32_t off = rx.got - sizeof(rx.hdr);
+            uint32_t want = rx.hdr.len - off;
+            void *dst = NULL;
+
+            /* Copy what fits into the destination, and discard the rest. */
+            if ( rx.buf && off < rx.size )
+            {
+                dst = rx.buf + off;
+                want = min(want, (uint32_t)(rx.size - off));
+            }
+
+            part = xenbus_read(dst, want);
+            if ( !part )
+                break;
+
+            progress = true;
+            rx.got += part;
+        }
+
+        if ( rx.got == sizeof(rx.hdr) + rx.hdr.len )
+        {
+            rx_complete();
+            rx.got = 0;
+        }
+    }
+
+    return progress;
+}
+
 /*
- * Write some raw data into the xenbus ring.  Waits for sufficient space to
- * appear if necessary.
+ * Notify xenstored of request data written since @p prod, if it might have
+ * gone idle.  It only waits for requests once it has consumed everything, so
+ * a kick is only needed if req_cons had caught up with @p prod.  The barrier
+ * orders the req_prod update against reading req_cons.
  */
-static void xenbus_write(const void *data, size_t len)
+static void xenbus_notify_req(struct xenstore_req *req, uint32_t prod)
+{
+    smp_mb();
+
+    if ( (int32_t)(ACCESS_ONCE(xb_ring->req_cons) - prod) >= 0 )
+        xenbus_kick(req);
+}
+
+/*
+ * Write some raw data into the xenbus ring, without notifying xenstored.
+ * Waits for sufficient space to appear if necessary, receiving replies
+ * meanwhile so xenstored can't stall on a full response ring.
+ */
+static void xenbus_write(struct xenstore_req *req, const void *data,
+                         size_t len)
 {
     uint32_t part, done = 0;
+    bool kicked = false;
 
     while ( len )
     {
@@ -33,13 +309,21 @@ static void xenbus_write(const void *data, size_t len)
 
         part = (XENBUS_RING_SIZE - 1) - mask_xenbus_idx(prod - cons);
 
-        /* No space?  Kick xenstored and wait for it to consume some data. */
+        /*
+         * No space?  Make sure xenstored knows about the data it has yet to
+         * consume (unnotified data from this request may be sitting in the
+         * ring), then wait for it to make progress.
+         */
         if ( !part )
         {
-            hypercall_evtchn_send(xb_port);
+            if ( !kicked )
+            {
+                xenbus_kick(req);
+                kicked = true;
+            }
 
-            if ( !test_and_clear_bit(xb_port, shared_info.evtchn_pending) )
-                hypercall_poll(xb_port);
+            if ( !xenbus_rx() )
+                xenbus_block(req);
 
             continue;
         }
@@ -62,101 +346,215 @@ static void xenbus_write(const void *data, size_t len)
     }
 }
 
-/*
- * Read some raw data from the xenbus ring.  Waits for sufficient data to
- * appear if necessary.
- */
-static void xenbus_read(void *data, size_t len)
+int xenstore_init(void)
 {
-    uint32_t part, done = 0;
+    /* Nothing to initialise.  Report the presence of the xenbus ring. */
+    return xb_port ? 0 : -ENODEV;
+}
 
-    while ( len )
-    {
-        uint32_t prod = ACCESS_ONCE(xb_ring->rsp_prod);
-        uint32_t cons = ACCESS_ONCE(xb_ring->rsp_cons);
+void xenstore_req_init(struct xenstore_req *req, void *buf, size_t size)
+{
+    ASSERT(size);
 
-        part = prod - cons;
+    memset(req, 0, sizeof(*req));
+    req->buf = buf;
+    req->size = size;
+}
 
-        /* No data?  Kick xenstored and wait for it to produce some data. */
-        if ( !part )
-        {
-            hypercall_evtchn_send(xb_port);
+int xenstore_submit(struct xenstore_req *req, enum xenstore_msg_type type,
+                    uint32_t tx, const char *path,
+                    const void *data, size_t len)
+{
+    size_t path_len = strlen(path) + 1; /* Must send the NUL terminator. */
+    struct xenstore_msg_hdr hdr = {
+        .type = type,
+        .tx_id = tx,
+        .len = path_len + len,
+    };
+    uint32_t prod;
 
-            if ( !test_and_clear_bit(xb_port, shared_info.evtchn_pending) )
-                hypercall_poll(xb_port);
+    if ( !xb_port )
+        return -ENODEV;
 
-            continue;
-        }
+    if ( hdr.len > XENSTORE_PAYLOAD_MAX )
+        return -E2BIG;
 
-        /* Avoid overrunning the ring. */
-        part = min(part, XENBUS_RING_SIZE - mask_xenbus_idx(cons));
+    hdr.req_id = req->req_id = next_req_id++;
+    req->next = NULL;
+    req->type = XS_INVALID;
+    req->len = 0;
+    req->rc = 0;
+    req->done = false;
+    req->kicks = 0;
+    req->polls = 0;
 
-        /* Don't read more than necessary. */
-        part = min(part, (unsigned int)len);
+    xenstore_stats.requests++;
 
-        memcpy(data + done, xb_ring->rsp + mask_xenbus_idx(cons), part);
+    *pending_tail = req;
+    pending_tail = &req->next;
 
-        /* Complete the data read before updating the new consumer index. */
-        smp_mb();
+    prod = ACCESS_ONCE(xb_ring->req_prod);
 
-        ACCESS_ONCE(xb_ring->rsp_cons) = cons + part;
+    xenbus_write(req, &hdr, sizeof(hdr));
+    xenbus_write(req, path, path_len);
+    if ( len )
+        xenbus_write(req, data, len);
 
-        len -= part;
-        done += part;
+    xenbus_notify_req(req, prod);
+
+    return 0;
+}
+
+void xenstore_process(void)
+{
+    if ( xb_port )
+        xenbus_rx();
+}
+
+int xenstore_wait(struct xenstore_req *req)
+{
+    while ( !ACCESS_ONCE(req->done) )
+    {
+        if ( !xenbus_rx() )
+            xenbus_block(req);
     }
+
+    return req->rc;
 }
 
-int xenstore_init(void)
+/*
+ * Issue a request and wait for the reply.  Returns the reply length, or
+ * -errno.
+ */
+static int xenstore_sync(enum xenstore_msg_type type, uint32_t tx,
+                         const char *path, const void *data, size_t len,
+                         char *buf, size_t size)
 {
-    /* Nothing to initialise.  Report the presence of the xenbus ring. */
-    return xb_port ? 0 : -ENODEV;
+    struct xenstore_req req;
+    int rc;
+
+    xenstore_req_init(&req, buf, size);
+
+    rc = xenstore_submit(&req, type, tx, path, data, len) ?:
+        xenstore_wait(&req);
+
+    if ( rc )
+        return rc;
+
+    if ( req.type != type )
+        return -EIO;
+
+    return req.len;
 }
 
 const char *xenstore_read(const char *path)
 {
-    struct xenstore_msg_hdr hdr = {
-        .type = XS_READ,
-        .len = strlen(path) + 1, /* Must send the NUL terminator. */
-    };
+    int rc = xenstore_read_buf(0, path, payload, sizeof(payload));
 
-    /* Write the header and path to read. */
-    xenbus_write(&hdr, sizeof(hdr));
-    xenbus_write(path, hdr.len);
+    return rc < 0 ? NULL : payload;
+}
 
-    /* Kick xenstored. */
-    hypercall_evtchn_send(xb_port);
+int xenstore_read_buf(uint32_t tx, const char *path, char *buf, size_t size)
+{
+    return xenstore_sync(XS_READ, tx, path, NULL, 0, buf, size);
+}
 
-    /* Read the response header. */
-    xenbus_read(&hdr, sizeof(hdr));
+int xenstore_write(uint32_t tx, const char *path, const char *value)
+{
+    char buf[16];
+    int rc = xenstore_sync(XS_WRITE, tx, path, value, strlen(value),
+                           buf, sizeof(buf));
 
-    if ( hdr.type != XS_READ )
-        return NULL;
+    return rc < 0 ? rc : 0;
+}
 
-    if ( hdr.len > XENSTORE_PAYLOAD_MAX )
-    {
-        /*
-         * Xenstored handed back too much data.  Drain it safely attempt to
-         * prevent the protocol from stalling.
-         */
-        while ( hdr.len )
-        {
-            unsigned int part = min(hdr.len, XENSTORE_PAYLOAD_MAX + 0u);
+int xenstore_directory(uint32_t tx, const char *path, char *buf, size_t size)
+{
+    return xenstore_sync(XS_DIRECTORY, tx, path, NULL, 0, buf, size);
+}
+
+int xenstore_rm(uint32_t tx, const char *path)
+{
+    char buf[16];
+    int rc = xenstore_sync(XS_RM, tx, path, NULL, 0, buf, sizeof(buf));
 
-            xenbus_read(payload, part);
+    return rc < 0 ? rc : 0;
+}
 
-            hdr.len -= part;
-        }
+int xenstore_parse_tx(const char *str, uint32_t *tx)
+{
+    uint32_t id = 0;
+
+    if ( !isdigit(*str) )
+        return -EIO;
+
+    while ( isdigit(*str) )
+        id = id * 10 + (*str++ - '0');
+
+    *tx = id;
+
+    return 0;
+}
+
+int xenstore_transaction_start(uint32_t *tx)
+{
+    char buf[16];
+    int rc = xenstore_sync(XS_TRANSACTION_START, 0, "", NULL, 0,
+                           buf, sizeof(buf));
+
+    return rc < 0 ? rc : xenstore_parse_tx(buf, tx);
+}
+
+int xenstore_transaction_end(uint32_t tx, bool commit)
+{
+    char buf[16];
+    int rc = xenstore_sync(XS_TRANSACTION_END, tx, commit ? "T" : "F",
+                           NULL, 0, buf, sizeof(buf));
+
+    return rc < 0 ? rc : 0;
+}
+
+int xenstore_watch(const char *path, const char *token)
+{
+    char buf[16];
+    int rc = xenstore_sync(XS_WATCH, 0, path, token, strlen(token) + 1,
+                           buf, sizeof(buf));
 
-        return NULL;
+    return rc < 0 ? rc : 0;
+}
+
+int xenstore_unwatch(const char *path, const char *token)
+{
+    char buf[16];
+    int rc = xenstore_sync(XS_UNWATCH, 0, path, token, strlen(token) + 1,
+                           buf, sizeof(buf));
+
+    return rc < 0 ? rc : 0;
+}
+
+int xenstore_wait_watch(char *buf, size_t size)
+{
+    unsigned int slot;
+    uint32_t len;
+
+    if ( !xb_port )
+        return -ENODEV;
+
+    while ( watch_cons == watch_prod )
+    {
+        if ( !xenbus_rx() )
+            xenbus_block(NULL);
     }
 
-    /* Read the response payload. */
-    xenbus_read(payload, hdr.len);
+    slot = watch_cons++ % NR_WATCH_EVENTS;
+    len = watch_events[slot].len;
+
+    if ( len > size )
+        return -ENOBUFS;
 
-    /* Safely terminate the reply, just in case xenstored didn't. */
-    payload[hdr.len] = '\0';
+    memcpy(buf, watch_events[slot].buf, len);
 
-    return payload;
+    return len;
 }
 
 /*
@@ -5,6 +5,22 @@
 #ifndef XEN_PUBLIC_HVM_PARAMS_H
 #define XEN_PUBLIC_HVM_PARAMS_H
 
+/*
+ * Parameter space for HVMOP_{set,get}_param.
+ *
+ * How should CPU0 event-channel notifications be delivered?
+ *
+ * If val == 0 then CPU0 event-channel notifications are not delivered.
+ * If val != 0, val[63:56] encodes the type, as follows:
+ *
+ * Type 2: val[7:0] is the vector number.  Check for XENFEAT_hvm_callback_vector
+ *         if this delivery method is available.
+ */
+#define HVM_PARAM_CALLBACK_IRQ 0
+
+#define HVM_PARAM_CALLBACK_TYPE_VECTOR   2
+#define HVM_PARAM_CALLBACK_TYPE_SHIFT    56
+
 #define HVM_PARAM_STORE_PFN       1
 #define HVM_PARAM_STORE_EVTCHN    2
 
@@ -8,6 +8,7 @@
 #include "event_channel.h"
 
 #define SCHEDOP_yield    0
+#define SCHEDOP_block    1
 #define SCHEDOP_shutdown 2
 #define SCHEDOP_poll     3
 
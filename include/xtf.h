@@ -22,8 +22,11 @@
 #include <xtf/atomic.h>
 #include <xtf/bitops.h>
 #include <xtf/elf.h>
+#include <xtf/evtchn.h>
 #include <xtf/grant_table.h>
 #include <xtf/hypercall.h>
+#include <xtf/multicall.h>
+#include <xtf/timer.h>
 #include <xtf/traps.h>
 #include <xtf/xenbus.h>
 #include <xtf/xenstore.h>
@@ -15,6 +15,15 @@
         ACCESS_ONCE(*p) = v;                    \
     })
 
+/* Atomically replace *p with v, returning the previous value. */
+#define xchg(p, v) __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST)
+
+/*
+ * Atomically replace *p with n, if it is equal to o.  Returns the previous
+ * value, which is equal to o on success.
+ */
+#define cmpxchg(p, o, n) __sync_val_compare_and_swap(p, o, n)
+
 #endif /* XTF_ATOMIC_H */
 
 /*
@@ -0,0 +1,155 @@
+/**
+ * @file include/xtf/evtchn.h
+ *
+ * Event channel handling.
+ *
+ * Ports are allocated and bound masked.  Registering a handler unmasks the
+ * port, after which its events are delivered by upcall, demultiplexed via the
+ * 2-level pending selector or FIFO queues, and passed to the handler.  Ports
+ * without a handler (including the console and xenstore ports) stay masked,
+ * and can be waited on with evtchn_poll().
+ *
+ * Only upcalls to vCPU 0 are handled.
+ */
+#ifndef XTF_EVTCHN_H
+#define XTF_EVTCHN_H
+
+#include <xtf/hypercall.h>
+
+#include <limits.h>
+
+/** Number of ports addressable by the 2-level ABI. */
+#define EVTCHN_2L_NR_PORTS (BITS_PER_LONG * BITS_PER_LONG)
+
+/**
+ * Number of ports which may have handlers, and the size of the FIFO event
+ * array.
+ */
+#define EVTCHN_NR_PORTS 4096
+
+typedef void (*evtchn_handler_t)(evtchn_port_t port, void *data);
+
+enum evtchn_abi {
+    EVTCHN_ABI_2L,
+    EVTCHN_ABI_FIFO,
+};
+
+/** The event channel ABI currently in use. */
+enum evtchn_abi evtchn_abi(void);
+
+/**
+ * Initialise event channel delivery.  Masks all ports, and arranges for
+ * upcalls to be delivered, but leaves them disabled.  Safe to call multiple
+ * times.
+ *
+ * @returns 0 or -errno.
+ */
+int evtchn_init(void);
+
+/**
+ * Switch to the FIFO ABI.  Ports remain bound, and ports with handlers remain
+ * unmasked.  There is no way back to the 2-level ABI.  Should be called with
+ * upcalls disabled.
+ *
+ * @returns 0, or -errno (e.g. -ENOSYS) if the FIFO ABI is unavailable, in
+ * which case the 2-level ABI remains in use.
+ */
+int evtchn_init_fifo(void);
+
+/**
+ * Arch specific part of evtchn_init(), registering the upcall entry point.
+ */
+int arch_init_evtchn(void);
+
+/**
+ * Allow upcalls to be delivered.  For HVM guests, this also enables
+ * interrupts.
+ */
+void evtchn_enable_upcalls(void);
+
+/**
+ * Prevent upcalls from being delivered.
+ * @returns whether upcalls were previously enabled.
+ */
+bool evtchn_disable_upcalls(void);
+
+/**
+ * Enable upcalls, and block until one has been delivered.  Upcalls are left
+ * enabled on return.
+ */
+void evtchn_block(void);
+
+/**
+ * Allocate a port for @p remote to bind to.
+ * @returns 0 or -errno, with the new port in @p port.
+ */
+int evtchn_alloc_unbound(domid_t remote, evtchn_port_t *port);
+
+/**
+ * Bind to port @p remote_port in domain @p remote.
+ * @returns 0 or -errno, with the new local port in @p port.
+ */
+int evtchn_bind_interdomain(domid_t remote, evtchn_port_t remote_port,
+                            evtchn_port_t *port);
+
+/**
+ * Bind a port for sending IPIs to @p vcpu.
+ * @returns 0 or -errno, with the new port in @p port.
+ */
+int evtchn_bind_ipi(unsigned int vcpu, evtchn_port_t *port);
+
+/**
+ * Bind a port to virtual interrupt @p virq, delivered to @p vcpu.
+ * @returns 0 or -errno, with the new port in @p port.
+ */
+int evtchn_bind_virq(unsigned int virq, unsigned int vcpu,
+                     evtchn_port_t *port);
+
+/**
+ * Close @p port, removing its handler.
+ * @returns 0 or -errno.
+ */
+int evtchn_close(evtchn_port_t port);
+
+/**
+ * Set the handler for @p port.  A non-NULL handler unmasks the port, while a
+ * NULL handler masks it.
+ */
+void evtchn_set_handler(evtchn_port_t port, evtchn_handler_t fn, void *data);
+
+/** Mask @p port. */
+void evtchn_mask(evtchn_port_t port);
+
+/**
+ * Unmask @p port.  Xen will deliver an upcall if the port became pending
+ * while it was masked.
+ */
+int evtchn_unmask(evtchn_port_t port);
+
+/**
+ * Clear pending on @p port.
+ * @returns whether @p port was pending.
+ */
+bool evtchn_test_and_clear_pending(evtchn_port_t port);
+
+/**
+ * Wait for a masked @p port to become pending, and clear it.
+ */
+void evtchn_poll(evtchn_port_t port);
+
+static inline int evtchn_send(evtchn_port_t port)
+{
+    return hypercall_evtchn_send(port);
+}
+
+#endif /* XTF_EVTCHN_H */
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
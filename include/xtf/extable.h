@@ -27,6 +27,16 @@
     _WORD fault, fixup, handler;                    \
     .popsection
 
+/**
+ * Create a fast exception table entry, recording the fault in @%eax.
+ * @param fault Faulting address.
+ * @param fixup Fixup address.
+ */
+#define _ASM_EXTABLE_FAST(fault, fixup)             \
+    .pushsection .ex_table.fast, "a";               \
+    _WORD fault, fixup;                             \
+    .popsection
+
 #else
 
 /**
@@ -40,6 +50,24 @@
     _WORD STR(fault) ", " STR(fixup) ", " STR(handler) ";\n"    \
     ".popsection;\n"
 
+/**
+ * Create a fast exception table entry.
+ *
+ * Faults at @p fault are recovered from in the assembly entry path, without
+ * saving state or calling into C.  The fault is recorded in @%eax, as
+ * ex_record_fault_eax() would, and execution resumes at @p fixup.
+ *
+ * The fast table is searched linearly on every exception, so is only
+ * suitable for a few entries on hot paths.
+ *
+ * @param fault Faulting address.
+ * @param fixup Fixup address.
+ */
+#define _ASM_EXTABLE_FAST(fault, fixup)                         \
+    ".pushsection .ex_table.fast, \"a\";\n"                     \
+    _WORD STR(fault) ", " STR(fixup) ";\n"                      \
+    ".popsection;\n"
+
 #endif
 
 /**
@@ -82,7 +110,8 @@ struct extable_entry
 
 /**
  * Sort the exception table.  Required to be called once on boot to make
- * searching efficient.
+ * searching efficient.  The build normally sorts the table already, in which
+ * case this only checks the order, and indexes large tables.
  */
 void sort_extable(void);
 
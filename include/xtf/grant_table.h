@@ -2,17 +2,30 @@
  * @file include/xtf/grant_table.h
  *
  * A driver for the Xen Grant Table interface.
+ *
+ * Initially, only the first frame of the grant table is mapped.  Grant
+ * references may be managed by hand, or allocated with gnttab_alloc_ref()
+ * (or gnttab_grant_access()), which grows the table on demand up to
+ * #GNTTAB_MAX_FRAMES.  References below #GNTTAB_NR_RESERVED_ENTRIES are
+ * never allocated, as they are reserved for the toolstack.
  */
 #ifndef XTF_GRANT_TABLE_H
 #define XTF_GRANT_TABLE_H
 
 #include <xtf/hypercall.h>
 
+/** Maximum number of grant table frames XTF will map. */
+#define GNTTAB_MAX_FRAMES 8
+
+/** Number of grant references reserved for the toolstack. */
+#define GNTTAB_NR_RESERVED_ENTRIES 8
+
 /**
  * Raw grant table mapping from Xen.
- * Valid once arch_map_gnttab() has returned successfully.
+ * The first #gnttab_nr_frames pages are valid once arch_map_gnttab() has
+ * returned successfully.
  */
-extern uint8_t gnttab_raw[PAGE_SIZE];
+extern uint8_t gnttab_raw[GNTTAB_MAX_FRAMES * PAGE_SIZE];
 
 /** Grant table in v1 format (aliases #gnttab_raw). */
 extern grant_entry_v1_t gnttab_v1[
@@ -22,10 +35,14 @@ extern grant_entry_v1_t gnttab_v1[
 extern grant_entry_v2_t gnttab_v2[
     sizeof(gnttab_raw) / sizeof(grant_entry_v2_t)];
 
+/** Number of grant table frames currently mapped under #gnttab_raw[]. */
+extern unsigned int gnttab_nr_frames;
+
 /**
- * Map the domains grant table under #gnttab_raw[].
+ * Map grant table frames [@p start, @p start + @p nr) under #gnttab_raw[],
+ * asking Xen to grow the table if necessary.
  */
-int arch_map_gnttab(void);
+int arch_map_gnttab(unsigned int start, unsigned int nr);
 
 
 /**
@@ -40,10 +57,54 @@ const char *gntst_strerror(int err);
  *
  * Sets a grant table version, and maps the grant table itself.  Safe to be
  * called multiple times to switch grant table version, as long as there are
- * no active grants.
+ * no active grants.  All references allocated with gnttab_alloc_ref() are
+ * implicitly freed.
  */
 int xtf_init_grant_table(unsigned int version);
 
+/**
+ * Grow the grant table to at least @p nr_frames frames.
+ * @returns 0, -E2BIG if @p nr_frames exceeds #GNTTAB_MAX_FRAMES, or -errno.
+ */
+int gnttab_grow(unsigned int nr_frames);
+
+/**
+ * Allocate a grant reference, growing the grant table if none are free.
+ * @returns 0 or -errno, with the reference in @p ref.
+ */
+int gnttab_alloc_ref(grant_ref_t *ref);
+
+/** Free a reference allocated with gnttab_alloc_ref(). */
+void gnttab_free_ref(grant_ref_t ref);
+
+/**
+ * Allocate a reference, and grant @p domid access to frame @p gfn through it.
+ * @returns 0 or -errno, with the reference in @p ref.
+ */
+int gnttab_grant_access(domid_t domid, unsigned long gfn, bool readonly,
+                        grant_ref_t *ref);
+
+/**
+ * Revoke access granted with gnttab_grant_access(), and free @p ref.
+ *
+ * @returns 0, or -EBUSY if the grant is still mapped, in which case access
+ * isn't revoked.  The v2 in-use flags live in the status frames, which
+ * aren't mapped, so in-use grants are only detected with the v1 format.
+ */
+int gnttab_end_access(grant_ref_t ref);
+
+/**
+ * Issue a batch of operations with a single hypercall.
+ *
+ * @returns 0, -errno if the hypercall failed, or -EIO if any operation
+ * failed, leaving its GNTST_* status in @p ops[].
+ */
+int gnttab_batch_map(struct gnttab_map_grant_ref *ops, unsigned int nr);
+/** @copydoc gnttab_batch_map() */
+int gnttab_batch_unmap(struct gnttab_unmap_grant_ref *ops, unsigned int nr);
+/** @copydoc gnttab_batch_map() */
+int gnttab_batch_copy(struct gnttab_copy *ops, unsigned int nr);
+
 #endif /* XTF_GRANT_TABLE_H */
 
 /*
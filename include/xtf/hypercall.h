@@ -123,6 +123,16 @@ static inline long hypercall_update_va_mapping(
 #endif
 }
 
+static inline long hypercall_set_timer_op(uint64_t timeout)
+{
+#ifdef __x86_64__
+    return HYPERCALL1(long, __HYPERVISOR_set_timer_op, timeout);
+#else
+    return HYPERCALL2(long, __HYPERVISOR_set_timer_op,
+                      (uint32_t)timeout, timeout >> 32);
+#endif
+}
+
 static inline long hypercall_xen_version(unsigned int cmd, void *arg)
 {
     return HYPERCALL2(long, __HYPERVISOR_xen_version, cmd, arg);
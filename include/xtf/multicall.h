@@ -0,0 +1,180 @@
+/**
+ * @file include/xtf/multicall.h
+ *
+ * Builder for batches of hypercalls, issued with `HYPERVISOR_multicall`.
+ *
+ * Usage:
+ *
+ *     static multicall_entry_t ents[32];
+ *     struct mc_batch mc;
+ *
+ *     mc_begin(&mc, ents, ARRAY_SIZE(ents));
+ *     mc_add_update_va_mapping(&mc, va, pte, UVMF_INVLPG);
+ *     mc_add_mmuext_op(&mc, ops, nr, NULL, DOMID_SELF);
+ *     ...
+ *     rc = mc_flush(&mc);
+ *
+ * Calls accumulate in the caller-provided entries, and are issued whenever
+ * they are full, or at mc_flush().  Every call's result is checked, and the
+ * first failure (a negative result) is retained until the next mc_begin().
+ */
+#ifndef XTF_MULTICALL_H
+#define XTF_MULTICALL_H
+
+#include <xtf/hypercall.h>
+#include <xtf/numbers.h>
+
+struct mc_batch {
+    multicall_entry_t *ents;    /**< Caller-provided storage.            */
+    unsigned int size;          /**< Capacity of @p ents.                */
+    unsigned int nr;            /**< Calls pending in @p ents.           */
+    unsigned int issued;        /**< Calls issued since mc_begin().      */
+    unsigned int failed;        /**< Index of the first failing call.    */
+    long rc;                    /**< Result of the first failing call.   */
+};
+
+/**
+ * Start a batch of hypercalls.
+ *
+ * @param mc   The batch.
+ * @param ents Storage for pending calls.
+ * @param size Number of calls which fit in @p ents.
+ */
+void mc_begin(struct mc_batch *mc, multicall_entry_t *ents, unsigned int size);
+
+/**
+ * Queue a hypercall, issuing the batch first if it is full.
+ *
+ * Prefer the typed mc_add_*() wrappers below.
+ *
+ * @returns the entry, with @p op set and all arguments zeroed.
+ */
+multicall_entry_t *mc_add(struct mc_batch *mc, unsigned long op);
+
+/**
+ * Issue all pending calls.
+ *
+ * Calls are numbered in the order they were added, from 0 at mc_begin().
+ * On failure, the number of the first failing call is in @p mc->failed.
+ * Results of the calls issued by this flush remain in @p mc->ents[].
+ *
+ * @returns 0, or the result of the first call to fail since mc_begin().
+ */
+long mc_flush(struct mc_batch *mc);
+
+static inline void mc_add_mmu_update(
+    struct mc_batch *mc, const mmu_update_t reqs[], unsigned int count,
+    unsigned int *done, unsigned int foreigndom)
+{
+    multicall_entry_t *e = mc_add(mc, __HYPERVISOR_mmu_update);
+
+    e->args[0] = _u(reqs);
+    e->args[1] = count;
+    e->args[2] = _u(done);
+    e->args[3] = foreigndom;
+}
+
+static inline void mc_add_mmuext_op(
+    struct mc_batch *mc, const mmuext_op_t ops[], unsigned int count,
+    unsigned int *done, unsigned int foreigndom)
+{
+    multicall_entry_t *e = mc_add(mc, __HYPERVISOR_mmuext_op);
+
+    e->args[0] = _u(ops);
+    e->args[1] = count;
+    e->args[2] = _u(done);
+    e->args[3] = foreigndom;
+}
+
+static inline void mc_add_update_va_mapping(
+    struct mc_batch *mc, unsigned long linear, uint64_t npte,
+    enum XEN_UVMF flags)
+{
+    multicall_entry_t *e = mc_add(mc, __HYPERVISOR_update_va_mapping);
+
+    e->args[0] = linear;
+    e->args[1] = npte;
+#ifdef __x86_64__
+    e->args[2] = flags;
+#else
+    e->args[2] = npte >> 32;
+    e->args[3] = flags;
+#endif
+}
+
+static inline void mc_add_memory_op(
+    struct mc_batch *mc, unsigned int cmd, void *arg)
+{
+    multicall_entry_t *e = mc_add(mc, __HYPERVISOR_memory_op);
+
+    e->args[0] = cmd;
+    e->args[1] = _u(arg);
+}
+
+static inline void mc_add_xen_version(
+    struct mc_batch *mc, unsigned int cmd, void *arg)
+{
+    multicall_entry_t *e = mc_add(mc, __HYPERVISOR_xen_version);
+
+    e->args[0] = cmd;
+    e->args[1] = _u(arg);
+}
+
+static inline void mc_add_grant_table_op(
+    struct mc_batch *mc, unsigned int cmd, void *args, unsigned int count)
+{
+    multicall_entry_t *e = mc_add(mc, __HYPERVISOR_grant_table_op);
+
+    e->args[0] = cmd;
+    e->args[1] = _u(args);
+    e->args[2] = count;
+}
+
+static inline void mc_add_vcpu_op(
+    struct mc_batch *mc, unsigned int cmd, unsigned int vcpu, void *extra)
+{
+    multicall_entry_t *e = mc_add(mc, __HYPERVISOR_vcpu_op);
+
+    e->args[0] = cmd;
+    e->args[1] = vcpu;
+    e->args[2] = _u(extra);
+}
+
+static inline void mc_add_sched_op(
+    struct mc_batch *mc, unsigned int cmd, void *arg)
+{
+    multicall_entry_t *e = mc_add(mc, __HYPERVISOR_sched_op);
+
+    e->args[0] = cmd;
+    e->args[1] = _u(arg);
+}
+
+static inline void mc_add_event_channel_op(
+    struct mc_batch *mc, unsigned int cmd, void *arg)
+{
+    multicall_entry_t *e = mc_add(mc, __HYPERVISOR_event_channel_op);
+
+    e->args[0] = cmd;
+    e->args[1] = _u(arg);
+}
+
+static inline void mc_add_physdev_op(
+    struct mc_batch *mc, unsigned int cmd, void *arg)
+{
+    multicall_entry_t *e = mc_add(mc, __HYPERVISOR_physdev_op);
+
+    e->args[0] = cmd;
+    e->args[1] = _u(arg);
+}
+
+#endif /* XTF_MULTICALL_H */
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,109 @@
+/**
+ * @file include/xtf/timer.h
+ *
+ * Timers, driven by Xen's per-vCPU single-shot timer.
+ *
+ * Armed timers are kept in deadline order, and Xen's single-shot timer is
+ * programmed for the earliest.  Expiry is signalled by `VIRQ_TIMER`, and
+ * handlers run in upcall context, so are only called while upcalls are
+ * enabled.  Times are Xen system time, in nanoseconds since boot.
+ *
+ * Usage, to wait with a timeout:
+ *
+ *     if ( !timer_wait(&done, MILLISECONDS(10)) )
+ *         return xtf_failure("Fail: Timed out\n");
+ *
+ * Only vCPU 0 is supported.
+ */
+#ifndef XTF_TIMER_H
+#define XTF_TIMER_H
+
+#include <xtf/lib.h>
+
+#define MICROSECONDS(x) ((uint64_t)(x) * 1000)
+#define MILLISECONDS(x) ((uint64_t)(x) * 1000000)
+#define SECONDS(x)      ((uint64_t)(x) * 1000000000)
+
+struct timer;
+
+typedef void (*timer_fn_t)(struct timer *t, void *data);
+
+/** A timer.  Must be zeroed before first use. */
+struct timer {
+    struct timer *next;         /**< Next timer, in deadline order.       */
+    uint64_t deadline;          /**< Absolute expiry, in ns.              */
+    uint64_t period;            /**< Reload interval, or 0 for one-shot.  */
+    timer_fn_t fn;              /**< Handler, or NULL.                    */
+    void *data;                 /**< Handler argument.                    */
+    bool armed;                 /**< Waiting to expire.                   */
+};
+
+/** Current Xen system time, in nanoseconds since boot. */
+uint64_t xen_system_time(void);
+
+/**
+ * Bind `VIRQ_TIMER`, and stop Xen's default periodic timer.  Safe to call
+ * multiple times.  Called implicitly by the other timer functions.
+ *
+ * @returns 0 or -errno.
+ */
+int timer_init(void);
+
+/**
+ * Arm @p t to expire at absolute time @p deadline.  A deadline in the past
+ * expires as soon as upcalls are enabled.  Re-arming an armed timer moves
+ * it.
+ *
+ * @param t        The timer.
+ * @param deadline Absolute expiry time, in ns.
+ * @param fn       Called on expiry, or NULL.
+ * @param data     Argument for @p fn.
+ */
+void timer_arm_ns(struct timer *t, uint64_t deadline,
+                  timer_fn_t fn, void *data);
+
+/**
+ * Arm @p t to first expire at @p deadline, and every @p period thereafter.
+ * Expiries are on a fixed cadence from @p deadline.  Periods which have
+ * completely passed by the time the handler runs are skipped.
+ */
+void timer_arm_periodic_ns(struct timer *t, uint64_t deadline,
+                           uint64_t period, timer_fn_t fn, void *data);
+
+/** Disarm @p t.  Safe to call on a disarmed or expired timer. */
+void timer_cancel(struct timer *t);
+
+/**
+ * @returns whether @p t is waiting to expire.  A periodic timer is armed
+ * until cancelled.
+ */
+static inline bool timer_armed(const struct timer *t)
+{
+    return ACCESS_ONCE(t->armed);
+}
+
+/**
+ * Block until @p ns nanoseconds from now.  Upcalls are left enabled on
+ * return.
+ */
+void timer_sleep_ns(uint64_t ns);
+
+/**
+ * Block until @p cond becomes true (typically set by an event channel
+ * handler), or @p timeout_ns passes.  Upcalls are left enabled on return.
+ *
+ * @returns the final value of @p cond.
+ */
+bool timer_wait(const volatile bool *cond, uint64_t timeout_ns);
+
+#endif /* XTF_TIMER_H */
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
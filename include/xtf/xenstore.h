@@ -2,25 +2,174 @@
  * @file include/xtf/xenstore.h
  *
  * Xenstore driver.
+ *
+ * Requests are asynchronous.  Each is described by a caller-owned
+ * #xenstore_req, which supplies the buffer for the reply.  Many requests may
+ * be in flight at once, and replies are matched to requests by `req_id`, so
+ * a caller can submit a batch of requests and only then wait for them:
+ *
+ *     for ( i = 0; i < nr; ++i )
+ *     {
+ *         xenstore_req_init(&reqs[i], bufs[i], sizeof(bufs[i]));
+ *         xenstore_submit(&reqs[i], XS_READ, 0, paths[i], NULL, 0);
+ *     }
+ *
+ *     for ( i = 0; i < nr; ++i )
+ *         rc = xenstore_wait(&reqs[i]);
+ *
+ * Synchronous wrappers are provided for the common operations.  Watch events
+ * are queued as they arrive, and collected with xenstore_wait_watch().
+ *
+ * Transaction ids are passed as @p tx, with 0 meaning no transaction.
+ *
+ * The xenbus event channel is only signalled when the other end may be
+ * waiting for it, i.e. when xenstored has consumed all outstanding requests,
+ * or the response ring was full.  Waiting blocks on the event channel until
+ * xenstored signals it.  Kicks and blocking polls are counted, globally in
+ * #xenstore_stats, and per request.
  */
 #ifndef XTF_XENSTORE_H
 #define XTF_XENSTORE_H
 
+#include <xtf/types.h>
+
+#include <xen/io/xs_wire.h>
+
+/** An in-flight xenstore request. */
+struct xenstore_req {
+    struct xenstore_req *next;  /**< Next request awaiting a reply.       */
+    uint32_t req_id;            /**< Request id, echoed in the reply.     */
+    uint32_t type;              /**< Reply type.                          */
+    char *buf;                  /**< Caller-provided reply buffer.        */
+    size_t size;                /**< Capacity of @p buf.                  */
+    size_t len;                 /**< Length of the reply payload.         */
+    int rc;                     /**< 0, or -errno.                        */
+    bool done;                  /**< Reply received.                      */
+    unsigned int kicks;         /**< Notifications sent on its behalf.    */
+    unsigned int polls;         /**< Times blocked waiting for it.        */
+};
+
+/** Xenbus transport counters, since boot. */
+struct xenstore_stats {
+    unsigned long requests;     /**< Requests submitted.                  */
+    unsigned long kicks;        /**< Notifications sent to xenstored.     */
+    unsigned long polls;        /**< Times blocked on the event channel.  */
+};
+
+extern struct xenstore_stats xenstore_stats;
+
 /**
  * Initialise XTF ready for xenstore communication.  May fail if there is no
  * xenbus ring found.
  */
 int xenstore_init(void);
 
+/**
+ * Prepare @p req for submission, with @p size bytes of @p buf for the reply.
+ * One byte is reserved to NUL terminate the reply.
+ */
+void xenstore_req_init(struct xenstore_req *req, void *buf, size_t size);
+
+/**
+ * Submit a request.  The payload is @p path including its NUL terminator,
+ * followed by @p len bytes of @p data.  Waits for ring space if necessary,
+ * processing replies meanwhile, but doesn't wait for the reply.
+ *
+ * @returns 0, or -errno if the request couldn't be sent.
+ */
+int xenstore_submit(struct xenstore_req *req, enum xenstore_msg_type type,
+                    uint32_t tx, const char *path,
+                    const void *data, size_t len);
+
+/**
+ * Process any replies which have arrived, without waiting.
+ */
+void xenstore_process(void);
+
+/**
+ * Wait for the reply to @p req.
+ *
+ * @returns 0, or -errno from an `XS_ERROR` reply, or -ENOBUFS if the reply
+ * was truncated to fit the buffer.
+ */
+int xenstore_wait(struct xenstore_req *req);
+
 /**
  * Issue a #XS_READ operation for @p key, waiting synchronously for the reply.
  *
  * Returns NULL on error.  The current implementation unmarshals data into a
  * static buffer, so the return pointer is only valid until a subsequent
- * xenstore operation.
+ * xenstore_read().
  */
 const char *xenstore_read(const char *key);
 
+/**
+ * Read @p path into @p buf, NUL terminated.
+ * @returns the length of the value, or -errno.
+ */
+int xenstore_read_buf(uint32_t tx, const char *path, char *buf, size_t size);
+
+/**
+ * Write @p value (without NUL terminator) to @p path.
+ * @returns 0 or -errno.
+ */
+int xenstore_write(uint32_t tx, const char *path, const char *value);
+
+/**
+ * List the children of @p path into @p buf, as consecutive NUL terminated
+ * names.
+ * @returns the total length of the names, or -errno.
+ */
+int xenstore_directory(uint32_t tx, const char *path, char *buf, size_t size);
+
+/**
+ * Remove @p path and its children.
+ * @returns 0 or -errno.
+ */
+int xenstore_rm(uint32_t tx, const char *path);
+
+/**
+ * Start a transaction.
+ * @returns 0 or -errno, with the transaction id in @p tx.
+ */
+int xenstore_transaction_start(uint32_t *tx);
+
+/**
+ * Parse the transaction id from the reply to an #XS_TRANSACTION_START
+ * request, for callers submitting their own.
+ * @returns 0 or -EIO, with the transaction id in @p tx.
+ */
+int xenstore_parse_tx(const char *str, uint32_t *tx);
+
+/**
+ * End transaction @p tx, committing it if @p commit.
+ * @returns 0, -EAGAIN if the transaction conflicted and should be retried,
+ * or -errno.
+ */
+int xenstore_transaction_end(uint32_t tx, bool commit);
+
+/**
+ * Watch @p path.  An event for @p path fires immediately, and for every
+ * subsequent change to it or its children.
+ * @returns 0 or -errno.
+ */
+int xenstore_watch(const char *path, const char *token);
+
+/** Remove a watch set with xenstore_watch().  @returns 0 or -errno. */
+int xenstore_unwatch(const char *path, const char *token);
+
+/**
+ * Wait for the next watch event, and copy it into @p buf as the NUL
+ * terminated path which changed, followed by the NUL terminated token.
+ * Events which didn't fit in the internal queue are dropped, and counted in
+ * xenstore_dropped_watches.
+ *
+ * @returns the length of the event, or -errno.
+ */
+int xenstore_wait_watch(char *buf, size_t size);
+
+extern unsigned int xenstore_dropped_watches;
+
 #endif /* XTF_XENSTORE_H */
 
 /*
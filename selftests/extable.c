@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* Provide just enough of the XTF environment for common/extable.c */
+#define XTF_LIB_H
+#define XTF_EXTABLE_H
+
+#include "../common/heapsort.c"
+
+struct extable_entry
+{
+    unsigned long fault, fixup;
+    bool (*handler)(void);
+};
+
+#define NR_ENTRIES 1000
+#define _STR(x) #x
+#define STR(x) _STR(x)
+
+/* Alias the linker symbols common/extable.c uses, to a static table. */
+struct extable_entry table[NR_ENTRIES];
+asm (".globl __start_ex_table; .set __start_ex_table, table;"
+     ".globl __stop_ex_table; .set __stop_ex_table, table + "
+     STR(NR_ENTRIES) " * 3 * 8");
+
+#include "../common/extable.c"
+
+/*
+ * Populate the table with unsorted, unique, randomly spaced fault addresses,
+ * sort and index it, and check that every entry, and no address between
+ * entries, is found.
+ */
+int main(void)
+{
+    unsigned long addr = 0x100000;
+    unsigned int i, failures = 0;
+
+    _Static_assert(sizeof(struct extable_entry) == 3 * 8, "Bad entry size");
+
+    srand(1);
+
+    for ( i = 0; i < NR_ENTRIES; ++i )
+    {
+        /* Mostly clustered, with occasional large gaps. */
+        addr += 1 + (rand() % 16) + ((rand() % 64) ? 0 : 0x10000);
+        table[i].fault = addr;
+        table[i].fixup = ~addr;
+    }
+
+    /* Shuffle, so sort_extable() takes the fallback path. */
+    for ( i = NR_ENTRIES - 1; i > 0; --i )
+    {
+        unsigned int j = rand() % (i + 1);
+
+        swap_extable_entry(&table[i], &table[j]);
+    }
+
+    sort_extable();
+
+    if ( !extable_is_sorted() )
+    {
+        printf("Table not sorted\n");
+        return 1;
+    }
+
+    if ( !extable_indexed )
+    {
+        printf("Table not indexed\n");
+        return 1;
+    }
+
+    for ( i = 0; i < NR_ENTRIES; ++i )
+    {
+        unsigned long fault = table[i].fault, a;
+        const struct extable_entry *ex = search_extable(fault);
+
+        if ( !ex || ex->fixup != ~fault )
+        {
+            printf("Entry %#lx not found\n", fault);
+            failures++;
+        }
+
+        /* Addresses between this entry and the next must not be found. */
+        for ( a = fault + 1;
+              a < (i + 1 < NR_ENTRIES ? table[i + 1].fault : fault + 32);
+              ++a )
+        {
+            if ( search_extable(a) )
+            {
+                printf("Bogus entry found for %#lx\n", a);
+                failures++;
+            }
+        }
+    }
+
+    if ( search_extable(table[0].fault - 1) || search_extable(0) ||
+         search_extable(~0ul) )
+    {
+        printf("Bogus entry found out of range\n");
+        failures++;
+    }
+
+    printf("%u failures\n", failures);
+
+    return !!failures;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,56 @@
+/**
+ * @file tests/fuzz-emul/lowlevel.h
+ *
+ * Declarations of the execution harness in lowlevel.S
+ *
+ * `fuzz_exec()` loads the general purpose registers (other than `%rsp`) and
+ * flags from a `struct fuzz_regs`, executes the instruction slot, and stores
+ * the resulting registers and flags back.  The slot consists of:
+ *
+ * - `fuzz_prefix[]`
+ *   - @ref FUZZ_PREFIX_LEN bytes, holding either the Forced Emulation Prefix,
+ *     or a NOP of the same length.
+ * - `fuzz_insn[]`
+ *   - @ref FUZZ_INSN_LEN bytes, holding the instruction under test, padded
+ *     with NOPs.
+ *
+ * A fault at `fuzz_insn` is recovered from via `ex_fuzz()`, which must
+ * record the fault and skip the remainder of the slot.
+ */
+#ifndef __LOWLEVEL_H__
+#define __LOWLEVEL_H__
+
+#define FUZZ_PREFIX_LEN 5
+#define FUZZ_INSN_LEN   16
+
+/* Index of the flags in struct fuzz_regs, after the 16 GPRs. */
+#define FUZZ_FLAGS      16
+
+#ifndef __ASSEMBLY__
+
+/* GPRs in instruction encoding order, with the rsp slot unused. */
+struct fuzz_regs {
+    unsigned long r[16];
+    unsigned long flags;
+};
+
+void fuzz_exec(struct fuzz_regs *regs);
+
+extern uint8_t fuzz_prefix[FUZZ_PREFIX_LEN];
+extern uint8_t fuzz_insn[FUZZ_INSN_LEN];
+
+bool ex_fuzz(struct cpu_regs *regs, const struct extable_entry *ex);
+
+#endif /* __ASSEMBLY__ */
+
+#endif /* __LOWLEVEL_H__ */
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
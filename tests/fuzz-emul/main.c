@@ -0,0 +1,590 @@
+/**
+ * @file tests/fuzz-emul/main.c
+ * @ref test-fuzz-emul
+ *
+ * @page test-fuzz-emul Differential emulator fuzzing
+ *
+ * Generate random instructions and register states, execute each natively
+ * and via the Forced Emulation Prefix, and compare the architectural results.
+ * Where @ref test-swint-emulation and @ref test-memop-seg check hand-picked
+ * cases, this covers a large random space, running until @ref DURATION has
+ * elapsed.  Nothing is printed per case, so the rate is limited by the cost
+ * of emulation.
+ *
+ * Instructions are built from templates, rather than being fully random
+ * bytes, so every case is a well-formed integer instruction with a known set
+ * of undefined flags, and memory operands only reference a scratch buffer.
+ * The templates cover:
+ *
+ * - ALU operations, in register, memory and immediate forms.
+ * - `test`, `mov`, `xchg`, `movzx`, `movsx`, `cmovcc`, `setcc`, `bswap`.
+ * - Shifts and rotates by 1, `%%cl` and an immediate, `shld`, `shrd`.
+ * - `not`, `neg`, `mul`, `imul`, `div`, `idiv`, `inc`, `dec`.
+ * - `bt`, `bts`, `btr`, `btc`, `xadd`, `cmpxchg`.
+ *
+ * Operand size, REX and segment override prefixes are chosen at random, as
+ * is a `lock` prefix, whether or not the instruction permits one.  Register
+ * values favour boundary values (0, 1, ~0, sign bits).
+ *
+ * The general purpose registers, arithmetic flags (less those architecturally
+ * undefined for the instruction), scratch buffer and any exception raised
+ * must match.  The first @ref MAX_REPORT mismatches are printed in detail.
+ *
+ * The seed is printed so a run can be reproduced.  Requires FEP, so Xen must
+ * be booted with `hvm_fep`.  64bit only, so the full register file is
+ * covered by a single harness.
+ *
+ * @see tests/fuzz-emul/main.c
+ */
+#include <xtf.h>
+
+#include "lowlevel.h"
+
+const char test_title[] = "Differential emulator fuzzing";
+
+bool test_needs_fep = true;
+
+#define DURATION   SECONDS(10)
+#define MAX_REPORT 8
+#define MEM_SIZE   128
+
+#define ARITH_FLAGS                                                     \
+    (X86_EFLAGS_CF | X86_EFLAGS_PF | X86_EFLAGS_AF | X86_EFLAGS_ZF |    \
+     X86_EFLAGS_SF | X86_EFLAGS_OF)
+
+static const char *const reg_names[16] = {
+    "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+    "r8",  "r9",  "r10", "r11", "r12", "r13", "r14", "r15",
+};
+
+static const uint8_t fep[FUZZ_PREFIX_LEN] = { 0x0f, 0x0b, 'x', 'e', 'n' };
+static const uint8_t nop5[FUZZ_PREFIX_LEN] = { 0x0f, 0x1f, 0x44, 0x00, 0x00 };
+
+/* Memory operands are %rbx or %r11 relative, and both point here. */
+static uint8_t mem[MEM_SIZE];
+
+static exinfo_t fault;
+
+static uint64_t seed;
+
+struct fuzz_case {
+    uint8_t insn[FUZZ_INSN_LEN];
+    unsigned int len;
+    unsigned long undef;        /* Flags undefined after the instruction. */
+    struct fuzz_regs regs;
+    uint8_t mem[MEM_SIZE];
+};
+
+struct result {
+    struct fuzz_regs regs;
+    exinfo_t fault;
+    uint8_t mem[MEM_SIZE];
+};
+
+/* Instruction generator state. */
+struct gen {
+    uint8_t *p;
+    bool opsize, rex_w, mem;
+};
+
+enum insn_class {
+    CLS_ALU,
+    CLS_ALU_IMM,
+    CLS_TEST_MOV,
+    CLS_MOV_IMM,
+    CLS_SHIFT,
+    CLS_GRP3,
+    CLS_INC_DEC,
+    CLS_IMUL,
+    CLS_MOVX,
+    CLS_BT,
+    CLS_CMOV,
+    CLS_SETCC,
+    CLS_XADD_CMPXCHG,
+    CLS_BSWAP,
+    CLS_SHXD,
+    NR_CLASSES,
+};
+
+bool ex_fuzz(struct cpu_regs *regs, const struct extable_entry *ex)
+{
+    fault = EXINFO(regs->entry_vector, regs->error_code);
+    regs->ip = ex->fixup;
+
+    return true;
+}
+
+/* xorshift64 */
+static uint64_t rnd(void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+
+    return seed;
+}
+
+static unsigned long rnd_value(void)
+{
+    switch ( rnd() & 7 )
+    {
+    case 0:  return 0;
+    case 1:  return 1;
+    case 2:  return ~0ul;
+    case 3:  return 0x80000000ul;
+    case 4:  return 0x8000000000000000ul;
+    case 5:  return rnd() & 0xff;
+    default: return rnd();
+    }
+}
+
+/* A register number 0-7, excluding %rsp. */
+static unsigned int rnd_reg(void)
+{
+    unsigned int reg;
+
+    do {
+        reg = rnd() & 7;
+    } while ( reg == 4 );
+
+    return reg;
+}
+
+static unsigned int width(const struct gen *g, bool byte)
+{
+    return byte ? 8 : g->rex_w ? 64 : g->opsize ? 16 : 32;
+}
+
+static void emit_imm(struct gen *g, unsigned int bytes)
+{
+    uint64_t imm = rnd();
+
+    for ( unsigned int i = 0; i < bytes; ++i, imm >>= 8 )
+        *g->p++ = imm;
+}
+
+/*
+ * Immediate of the operand size, for the instructions which take one.  With
+ * REX.W it is 4 bytes, sign extended, whether or not 0x66 is present too.
+ */
+static void emit_immz(struct gen *g)
+{
+    emit_imm(g, g->rex_w ? 4 : g->opsize ? 2 : 4);
+}
+
+/*
+ * Emit a ModRM byte with @p reg.  The r/m operand is either a register, or
+ * (if @p mem_ok) %rbx/%r11 with an 8 bit displacement within the buffer.
+ */
+static void emit_modrm(struct gen *g, unsigned int reg, bool mem_ok)
+{
+    if ( mem_ok && (rnd() & 1) )
+    {
+        *g->p++ = 0x40 | (reg << 3) | 3;
+        *g->p++ = rnd() & 0x3f;
+        g->mem = true;
+    }
+    else
+        *g->p++ = 0xc0 | (reg << 3) | rnd_reg();
+}
+
+static unsigned long logic_undef(unsigned int alu_op)
+{
+    /* or, and and xor leave AF undefined. */
+    return (alu_op == 1 || alu_op == 4 || alu_op == 6) ? X86_EFLAGS_AF : 0;
+}
+
+/* Undefined flags for shift/rotate @p op by @p count. */
+static unsigned long shift_undef(unsigned int op, unsigned long count,
+                                 unsigned int width)
+{
+    unsigned long undef = 0;
+
+    count &= width == 64 ? 0x3f : 0x1f;
+
+    if ( !count )
+        return 0;
+
+    if ( op >= 4 )
+        undef |= X86_EFLAGS_AF;
+    if ( count > 1 )
+        undef |= X86_EFLAGS_OF;
+    if ( count >= width )
+        undef |= X86_EFLAGS_CF;
+
+    return undef;
+}
+
+/* Generate an instruction into @p c, given its register state. */
+static void gen_insn(struct fuzz_case *c)
+{
+    static const uint8_t segs[] = { 0x26, 0x2e, 0x36, 0x3e };
+    struct gen g = { .p = c->insn };
+    unsigned int cls = rnd() % NR_CLASSES, op, opc, count;
+    unsigned long undef = 0;
+    uint64_t r = rnd();
+
+    if ( r & 1 )
+        *g.p++ = segs[(r >> 1) & 3];
+    if ( !((r >> 3) & 3) && cls != CLS_BSWAP )
+    {
+        *g.p++ = 0x66;
+        g.opsize = true;
+    }
+    if ( !((r >> 5) & 7) )
+        *g.p++ = 0xf0;
+    if ( (r >> 8) & 1 )
+    {
+        /* REX.W, R and B.  X is unused, as there is no SIB byte. */
+        uint8_t rex = 0x40 | ((r >> 9) & 0xd);
+
+        *g.p++ = rex;
+        g.rex_w = rex & 8;
+    }
+
+    r = rnd();
+
+    switch ( cls )
+    {
+    case CLS_ALU:
+        op = r & 7;
+        *g.p++ = (op << 3) | ((r >> 3) & 3);
+        emit_modrm(&g, rnd_reg(), true);
+        undef = logic_undef(op);
+        break;
+
+    case CLS_ALU_IMM:
+        opc = (const uint8_t[]){ 0x80, 0x81, 0x83 }[(r & 0xff) % 3];
+        op = (r >> 8) & 7;
+        *g.p++ = opc;
+        emit_modrm(&g, op, true);
+        if ( opc == 0x81 )
+            emit_immz(&g);
+        else
+            emit_imm(&g, 1);
+        undef = logic_undef(op);
+        break;
+
+    case CLS_TEST_MOV:
+        /* test, xchg and mov, in 84-8b. */
+        opc = 0x84 + (r & 7);
+        *g.p++ = opc;
+        emit_modrm(&g, rnd_reg(), true);
+        undef = opc < 0x86 ? X86_EFLAGS_AF : 0;
+        break;
+
+    case CLS_MOV_IMM:
+        opc = 0xc6 | (r & 1);
+        *g.p++ = opc;
+        emit_modrm(&g, 0, true);
+        if ( opc & 1 )
+            emit_immz(&g);
+        else
+            emit_imm(&g, 1);
+        break;
+
+    case CLS_SHIFT:
+        /* By immediate (c0/c1), by 1 (d0/d1) or by %cl (d2/d3). */
+        opc = (const uint8_t[]){ 0xc0, 0xd0, 0xd2 }[(r & 0xff) % 3] |
+            ((r >> 8) & 1);
+        op = (r >> 9) & 7;
+        *g.p++ = opc;
+        emit_modrm(&g, op, true);
+
+        if ( opc < 0xd0 )
+        {
+            count = rnd() & 0xff;
+            *g.p++ = count;
+        }
+        else if ( opc < 0xd2 )
+            count = 1;
+        else
+            count = c->regs.r[1] & 0xff;
+
+        undef = shift_undef(op, count, width(&g, !(opc & 1)));
+        break;
+
+    case CLS_GRP3:
+        /* test, not, neg, mul, imul, div, idiv.  /1 is an alias of test. */
+        opc = 0xf6 | (r & 1);
+        do {
+            op = rnd() & 7;
+        } while ( op == 1 );
+        *g.p++ = opc;
+        emit_modrm(&g, op, true);
+
+        switch ( op )
+        {
+        case 0:
+            if ( opc & 1 )
+                emit_immz(&g);
+            else
+                emit_imm(&g, 1);
+            undef = X86_EFLAGS_AF;
+            break;
+
+        case 4: case 5:
+            undef = (X86_EFLAGS_SF | X86_EFLAGS_ZF |
+                     X86_EFLAGS_AF | X86_EFLAGS_PF);
+            break;
+
+        case 6: case 7:
+            undef = ARITH_FLAGS;
+            break;
+        }
+        break;
+
+    case CLS_INC_DEC:
+        *g.p++ = 0xfe | (r & 1);
+        emit_modrm(&g, (r >> 1) & 1, true);
+        break;
+
+    case CLS_IMUL:
+        /* imul r, r/m (0f af), with imm32 (69) or with imm8 (6b). */
+        switch ( (r & 0xff) % 3 )
+        {
+        case 0:
+            *g.p++ = 0x0f;
+            *g.p++ = 0xaf;
+            emit_modrm(&g, rnd_reg(), true);
+            break;
+
+        case 1:
+            *g.p++ = 0x69;
+            emit_modrm(&g, rnd_reg(), true);
+            emit_immz(&g);
+            break;
+
+        case 2:
+            *g.p++ = 0x6b;
+            emit_modrm(&g, rnd_reg(), true);
+            emit_imm(&g, 1);
+            break;
+        }
+        undef = (X86_EFLAGS_SF | X86_EFLAGS_ZF |
+                 X86_EFLAGS_AF | X86_EFLAGS_PF);
+        break;
+
+    case CLS_MOVX:
+        *g.p++ = 0x0f;
+        *g.p++ = (const uint8_t[]){ 0xb6, 0xb7, 0xbe, 0xbf }[r & 3];
+        emit_modrm(&g, rnd_reg(), true);
+        break;
+
+    case CLS_BT:
+        *g.p++ = 0x0f;
+        if ( r & 1 )
+        {
+            /* Immediate form (0f ba /4-7). */
+            *g.p++ = 0xba;
+            emit_modrm(&g, 4 + ((r >> 1) & 3), true);
+            emit_imm(&g, 1);
+        }
+        else
+        {
+            /*
+             * Register form (0f a3/ab/b3/bb).  Register destination only, as
+             * the bit offset of a memory destination is unbounded.
+             */
+            *g.p++ = 0xa3 | ((r >> 1) & 3) << 3;
+            emit_modrm(&g, rnd_reg(), false);
+        }
+        undef = (X86_EFLAGS_OF | X86_EFLAGS_SF | X86_EFLAGS_ZF |
+                 X86_EFLAGS_AF | X86_EFLAGS_PF);
+        break;
+
+    case CLS_CMOV:
+        *g.p++ = 0x0f;
+        *g.p++ = 0x40 | (r & 0xf);
+        emit_modrm(&g, rnd_reg(), true);
+        break;
+
+    case CLS_SETCC:
+        *g.p++ = 0x0f;
+        *g.p++ = 0x90 | (r & 0xf);
+        emit_modrm(&g, 0, true);
+        break;
+
+    case CLS_XADD_CMPXCHG:
+        *g.p++ = 0x0f;
+        *g.p++ = (const uint8_t[]){ 0xb0, 0xb1, 0xc0, 0xc1 }[r & 3];
+        emit_modrm(&g, rnd_reg(), true);
+        break;
+
+    case CLS_BSWAP:
+        *g.p++ = 0x0f;
+        *g.p++ = 0xc8 | rnd_reg();
+        break;
+
+    case CLS_SHXD:
+        /* shld/shrd by immediate, with the count below the operand size. */
+        opc = (r & 1) ? 0xac : 0xa4;
+        count = rnd() & (width(&g, false) - 1);
+        *g.p++ = 0x0f;
+        *g.p++ = opc;
+        emit_modrm(&g, rnd_reg(), true);
+        *g.p++ = count;
+
+        if ( count )
+            undef = X86_EFLAGS_AF | (count > 1 ? X86_EFLAGS_OF : 0);
+        break;
+    }
+
+    c->len = g.p - c->insn;
+    c->undef = undef;
+
+    if ( g.mem )
+        c->regs.r[3] = c->regs.r[11] = _u(mem);
+}
+
+static void gen_case(struct fuzz_case *c)
+{
+    for ( unsigned int i = 0; i < ARRAY_SIZE(c->regs.r); ++i )
+        c->regs.r[i] = i == 4 ? 0 : rnd_value();
+
+    c->regs.flags = X86_EFLAGS_MBS | (rnd() & ARITH_FLAGS);
+
+    for ( unsigned int i = 0; i < MEM_SIZE; i += 8 )
+        *(uint64_t *)&c->mem[i] = rnd();
+
+    gen_insn(c);
+
+    memcpy(fuzz_insn, c->insn, c->len);
+    memset(fuzz_insn + c->len, 0x90, FUZZ_INSN_LEN - c->len);
+}
+
+static void run(const struct fuzz_case *c, bool emul, struct result *res)
+{
+    memcpy(fuzz_prefix, emul ? fep : nop5, FUZZ_PREFIX_LEN);
+    memcpy(mem, c->mem, MEM_SIZE);
+
+    res->regs = c->regs;
+    fault = 0;
+
+    fuzz_exec(&res->regs);
+
+    res->fault = fault;
+    memcpy(res->mem, mem, MEM_SIZE);
+}
+
+static void print_fault(const char *name, exinfo_t ex)
+{
+    if ( ex )
+        printk(" %s %pe", name, _p(ex));
+    else
+        printk(" %s none", name);
+}
+
+/* Compare the results of @p c.  Returns true if they match. */
+static bool compare(const struct fuzz_case *c, const struct result *native,
+                    const struct result *emul, bool report)
+{
+    unsigned long flags_mask = (ARITH_FLAGS | X86_EFLAGS_DF) & ~c->undef;
+    bool ok = true;
+
+    if ( native->fault != emul->fault )
+    {
+        ok = false;
+        if ( report )
+        {
+            printk("  Fault:");
+            print_fault("native", native->fault);
+            print_fault("emulated", emul->fault);
+            printk("\n");
+        }
+    }
+
+    for ( unsigned int i = 0; i < ARRAY_SIZE(c->regs.r); ++i )
+    {
+        if ( i == 4 || native->regs.r[i] == emul->regs.r[i] )
+            continue;
+
+        ok = false;
+        if ( report )
+            printk("  %-5s: in %016lx, native %016lx, emulated %016lx\n",
+                   reg_names[i], c->regs.r[i],
+                   native->regs.r[i], emul->regs.r[i]);
+    }
+
+    if ( (native->regs.flags ^ emul->regs.flags) & flags_mask )
+    {
+        ok = false;
+        if ( report )
+            printk("  flags: in %08lx, native %08lx, emulated %08lx, "
+                   "compared %08lx\n", c->regs.flags, native->regs.flags,
+                   emul->regs.flags, flags_mask);
+    }
+
+    for ( unsigned int i = 0; i < MEM_SIZE; ++i )
+    {
+        if ( native->mem[i] == emul->mem[i] )
+            continue;
+
+        ok = false;
+        if ( report )
+            printk("  mem+%#x: in %02x, native %02x, emulated %02x\n",
+                   i, c->mem[i], native->mem[i], emul->mem[i]);
+        break;
+    }
+
+    return ok;
+}
+
+void test_main(void)
+{
+    static struct fuzz_case c;
+    static struct result native, emul;
+    unsigned long cases, faults = 0, mismatches = 0;
+    uint64_t start, elapsed;
+
+    seed = rdtsc() | 1;
+    printk("Seed %#lx, running for %lus\n", seed,
+           (unsigned long)(DURATION / SECONDS(1)));
+
+    start = xen_system_time();
+    for ( cases = 0; ; ++cases )
+    {
+        /* Sample the time infrequently, to keep the per-case cost down. */
+        if ( !(cases & 1023) && xen_system_time() - start >= DURATION )
+            break;
+
+        gen_case(&c);
+        run(&c, false, &native);
+        run(&c, true, &emul);
+
+        if ( native.fault )
+            faults++;
+
+        if ( compare(&c, &native, &emul, false) )
+            continue;
+
+        if ( ++mismatches > MAX_REPORT )
+            continue;
+
+        printk("Mismatch:");
+        for ( unsigned int i = 0; i < c.len; ++i )
+            printk(" %02x", c.insn[i]);
+        printk("\n");
+        compare(&c, &native, &emul, true);
+    }
+    elapsed = xen_system_time() - start;
+
+    printk("%lu cases, %lu faulting, %lu cases/s, %lu mismatches\n",
+           cases, faults, cases * SECONDS(1) / (elapsed ?: 1), mismatches);
+
+    if ( mismatches )
+        return xtf_failure("Fail: %lu of %lu cases mismatched\n",
+                           mismatches, cases);
+
+    xtf_success(NULL);
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
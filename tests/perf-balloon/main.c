@@ -0,0 +1,270 @@
+/**
+ * @file tests/perf-balloon/main.c
+ * @ref test-perf-balloon
+ *
+ * @page test-perf-balloon Ballooning throughput
+ *
+ * Measure the throughput of `XENMEM_decrease_reservation` and
+ * `XENMEM_populate_physmap`, as used to balloon memory out of and back into a
+ * guest, for extents of order 0 (4k), 9 (2M) and 18 (1G), at varying batch
+ * sizes (extents per hypercall).  The test is built with the `hap` and
+ * `shadow` variations, so a single `xtf-runner` invocation gathers numbers
+ * for both paging modes.
+ *
+ * The test is given 2G of RAM, and the upper 1G is released and repopulated,
+ * repeatedly.  Order 0 uses only the first 64M of the region, to keep the
+ * runtime reasonable.  Throughput is reported in pages (4k) per second.
+ *
+ * By default, Xen limits unprivileged domains to order 9 extents
+ * (`memop-max-order`), and large extents can only be populated while Xen has
+ * sufficiently large free chunks of memory.  Where releasing or populating
+ * falls short, whatever was released is repopulated with 4k pages, and the
+ * order is reported as `n/a`.
+ *
+ * Finally, the region is filled with a pattern, released and repopulated,
+ * and checked.  Xen only scrubs memory freed by a dying domain (it is a live
+ * guest's responsibility to scrub memory it releases), so pages may come back
+ * containing their previous contents.  Pages containing data which isn't the
+ * test's own pattern are reported with a warning.
+ *
+ * @see tests/perf-balloon/main.c
+ */
+#include <xtf.h>
+
+#include <arch/div.h>
+
+const char test_title[] = "Ballooning throughput";
+
+#define REGION_START GB(1)
+#define REGION_SIZE  GB(1)
+#define MAX_BATCH    256
+
+#define PATTERN      0x5a5a5a5a00000000ull
+
+static const struct order {
+    unsigned int order;
+    unsigned long size;         /* Bytes of the region used. */
+} orders[] = {
+    {  0, MB(64) },
+    {  9, REGION_SIZE },
+    { 18, REGION_SIZE },
+};
+
+static const unsigned int batch_sizes[] = { 1, 16, 256 };
+
+static unsigned long gfns[MAX_BATCH];
+
+/* Rate for an operation which fell short. */
+#define RATE_NA (~0u)
+
+static unsigned long region_gfn(unsigned long offset)
+{
+    return (REGION_START + offset) >> PAGE_SHIFT;
+}
+
+/*
+ * Issue @p op for bytes [@p start, @p end) of the region, in extents of
+ * @p order, @p batch extents per hypercall.  Returns the offset reached by
+ * successful extents.
+ */
+static unsigned long memop_region(unsigned int op, unsigned int order,
+                                  unsigned int batch, unsigned long start,
+                                  unsigned long end)
+{
+    unsigned long extent = PAGE_SIZE << order, offset = start;
+
+    while ( offset < end )
+    {
+        unsigned int nr = 0;
+        long rc;
+
+        for ( ; nr < batch && offset + nr * extent < end; ++nr )
+            gfns[nr] = region_gfn(offset + nr * extent);
+
+        struct xen_memory_reservation res = {
+            .extent_start = gfns,
+            .nr_extents = nr,
+            .extent_order = order,
+            .domid = DOMID_SELF,
+        };
+
+        rc = hypercall_memory_op(op, &res);
+        if ( rc > 0 )
+            offset += rc * extent;
+
+        if ( rc != (long)nr )
+            break;
+    }
+
+    return offset;
+}
+
+/* Repopulate the region from @p offset with 4k pages, after a failure. */
+static bool repopulate(unsigned long offset, unsigned long size)
+{
+    unsigned long done = memop_region(XENMEM_populate_physmap, 0, MAX_BATCH,
+                                      offset, size);
+
+    if ( done != size )
+    {
+        xtf_error("Error: Unable to repopulate region at +%#lx\n", done);
+        return false;
+    }
+
+    return true;
+}
+
+/* Pages per second, for @p bytes taking @p ns. */
+static uint32_t rate(unsigned long bytes, uint64_t ns)
+{
+    uint64_t pages = (uint64_t)(bytes >> PAGE_SHIFT) * 1000000;
+
+    /* Elapsed time in us, so the divisor fits in 32 bits. */
+    divmod64(&ns, 1000);
+    divmod64(&pages, ns ?: 1);
+
+    return pages;
+}
+
+/*
+ * Release and repopulate the region.  Returns false on a hard error.  Sets
+ * *@p avail to false, and the rates which couldn't be measured to RATE_NA,
+ * if @p order couldn't be released or populated.
+ */
+static bool measure(const struct order *o, unsigned int batch,
+                    uint32_t *release, uint32_t *populate, bool *avail)
+{
+    unsigned long done;
+    uint64_t start;
+
+    start = xen_system_time();
+    done = memop_region(XENMEM_decrease_reservation, o->order, batch,
+                        0, o->size);
+    *release = rate(done, xen_system_time() - start);
+
+    /* e.g. @p order exceeds the domain's memop-max-order. */
+    if ( done != o->size )
+    {
+        *release = *populate = RATE_NA;
+        *avail = false;
+        return repopulate(0, done);
+    }
+
+    start = xen_system_time();
+    done = memop_region(XENMEM_populate_physmap, o->order, batch,
+                        0, o->size);
+    *populate = rate(done, xen_system_time() - start);
+
+    if ( done != o->size )
+    {
+        *populate = RATE_NA;
+        *avail = false;
+        return repopulate(done, o->size);
+    }
+
+    return true;
+}
+
+static void print_rate(uint32_t rate)
+{
+    if ( rate == RATE_NA )
+        printk(" %12s", "n/a");
+    else
+        printk(" %12u", rate);
+}
+
+/* Fill, release, repopulate, and check the region's contents. */
+static void check_scrub(void)
+{
+    unsigned long own = 0, foreign = 0;
+
+    for ( unsigned long off = 0; off < REGION_SIZE; off += PAGE_SIZE )
+    {
+        uint64_t *p = _p(REGION_START + off);
+
+        for ( unsigned int i = 0; i < PAGE_SIZE / sizeof(*p); ++i )
+            p[i] = PATTERN | region_gfn(off);
+    }
+
+    if ( memop_region(XENMEM_decrease_reservation, 9, MAX_BATCH,
+                      0, REGION_SIZE) != REGION_SIZE ||
+         !repopulate(0, REGION_SIZE) )
+        return xtf_error("Error: Unable to cycle region for scrub check\n");
+
+    for ( unsigned long off = 0; off < REGION_SIZE; off += PAGE_SIZE )
+    {
+        const uint64_t *p = _p(REGION_START + off);
+        uint64_t bits = 0;
+
+        for ( unsigned int i = 0; i < PAGE_SIZE / sizeof(*p); ++i )
+            bits |= p[i];
+
+        if ( !bits )
+            continue;
+
+        if ( (p[0] & ~0xffffffffull) == PATTERN )
+            own++;
+        else
+            foreign++;
+    }
+
+    printk("Scrub check: %lu pages, %lu with own data, %lu with other data\n",
+           (unsigned long)(REGION_SIZE >> PAGE_SHIFT), own, foreign);
+
+    if ( foreign )
+        xtf_warning("Warning: %lu repopulated pages contain other data\n",
+                    foreign);
+}
+
+void test_main(void)
+{
+    domid_t domid = DOMID_SELF;
+    long max = hypercall_memory_op(XENMEM_maximum_gpfn, &domid);
+
+    if ( max < 0 || (unsigned long)max < region_gfn(REGION_SIZE - 1) )
+        return xtf_error("Error: Insufficient RAM: max gpfn %#lx\n", max);
+
+    printk("  %5s %5s %12s %12s\n", "Order", "Batch",
+           "Release/s", "Populate/s");
+
+    for ( unsigned int o = 0; o < ARRAY_SIZE(orders); ++o )
+    {
+        bool avail = true;
+
+        for ( unsigned int b = 0; avail && b < ARRAY_SIZE(batch_sizes); ++b )
+        {
+            uint32_t release, populate;
+
+            /* More extents than the region holds duplicate a smaller batch. */
+            if ( b && ((unsigned long)batch_sizes[b - 1] <<
+                       (orders[o].order + PAGE_SHIFT)) >= orders[o].size )
+                break;
+
+            if ( !measure(&orders[o], batch_sizes[b],
+                          &release, &populate, &avail) )
+                return;
+
+            printk("  %5u %5u", orders[o].order, batch_sizes[b]);
+            print_rate(release);
+            print_rate(populate);
+            printk("\n");
+        }
+    }
+
+    check_scrub();
+
+    if ( xtf_status_reported() )
+        return;
+
+    xtf_success(NULL);
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,283 @@
+/**
+ * @file tests/perf-cpuid/main.c
+ * @ref test-perf-cpuid
+ *
+ * @page test-perf-cpuid CPUID cost
+ *
+ * Measure the cost of `CPUID`, for every leaf and subleaf visible to the
+ * guest, executed in three ways:
+ *
+ * - `Native`: A plain `CPUID` in the kernel.  Always intercepted for HVM
+ *   guests.  For PV guests, only intercepted if Xen uses CPUID Faulting.
+ * - `FEP`: A `CPUID` with the Forced Emulation Prefix (`pv_cpuid()`), taking
+ *   Xen's emulation path.  Always available to PV guests, and to HVM guests
+ *   if Xen was booted with `hvm_fep`.
+ * - `Faulting`: A `CPUID` in userspace with CPUID Faulting enabled (see
+ *   @ref test-cpuid-faulting), so each `CPUID` is a @#GP[0] round trip through
+ *   the guest kernel.  This is the cost a kernel emulating `CPUID` for its
+ *   userspace pays, before doing any emulation.
+ *
+ * Leaves are enumerated as @ref test-cpuid does.  The average number of TSC
+ * cycles per `CPUID`, over @ref ITERS executions, is reported per leaf.
+ *
+ * @see tests/perf-cpuid/main.c
+ */
+#include <xtf.h>
+
+#include <arch/div.h>
+
+const char test_title[] = "CPUID cost";
+
+#define ITERS      200
+#define MAX_LEAVES 256
+
+static struct leaf {
+    uint32_t leaf, subleaf;
+    uint32_t native, fep, faulting;
+} leaves[MAX_LEAVES];
+static unsigned int nr_leaves;
+
+static uint32_t __user_data user_leaf, user_subleaf;
+static uint64_t __user_data user_cycles;
+
+static void add_leaf(uint32_t leaf, uint32_t subleaf)
+{
+    if ( nr_leaves < ARRAY_SIZE(leaves) )
+        leaves[nr_leaves++] = (struct leaf){
+            .leaf = leaf, .subleaf = subleaf,
+        };
+}
+
+static bool is_xen_base(cpuid_count_fn_t cpuid_fn, uint32_t base)
+{
+    uint32_t eax, ebx, ecx, edx;
+
+    cpuid_fn(base, 0, &eax, &ebx, &ecx, &edx);
+
+    return (ebx == XEN_CPUID_SIGNATURE_EBX &&
+            ecx == XEN_CPUID_SIGNATURE_ECX &&
+            edx == XEN_CPUID_SIGNATURE_EDX);
+}
+
+/* Add the leaves in [@p first, @p last], and their subleaves. */
+static void add_range(cpuid_count_fn_t cpuid_fn, uint32_t first, uint32_t last)
+{
+    for ( uint32_t leaf = first; leaf <= last; ++leaf )
+    {
+        uint32_t eax, ebx, ecx, edx, sub;
+        uint64_t xstates;
+
+        switch ( leaf )
+        {
+        case 0x4:
+            for ( sub = 0; sub < 64; ++sub )
+            {
+                cpuid_fn(leaf, sub, &eax, &ebx, &ecx, &edx);
+                if ( !(eax & 0x1f) )
+                    break;
+                add_leaf(leaf, sub);
+            }
+            break;
+
+        case 0x7:
+            cpuid_fn(leaf, 0, &eax, &ebx, &ecx, &edx);
+            for ( sub = 0; sub <= eax && sub < 64; ++sub )
+                add_leaf(leaf, sub);
+            break;
+
+        case 0xd:
+            cpuid_fn(leaf, 0, &eax, &ebx, &ecx, &edx);
+            xstates = ((uint64_t)edx << 32) | eax;
+
+            add_leaf(leaf, 0);
+            add_leaf(leaf, 1);
+            for ( sub = 2; sub < 63; ++sub )
+                if ( xstates & (1ull << sub) )
+                    add_leaf(leaf, sub);
+            break;
+
+        default:
+            add_leaf(leaf, 0);
+            break;
+        }
+    }
+}
+
+static void collect_leaves(cpuid_count_fn_t cpuid_fn)
+{
+    uint32_t max, tmp;
+
+    cpuid_fn(0, 0, &max, &tmp, &tmp, &tmp);
+    add_range(cpuid_fn, 0, min(max, 0xffffu));
+
+    for ( uint32_t base = 0x40000000; base <= 0x40000100; base += 0x100 )
+    {
+        cpuid_fn(base, 0, &max, &tmp, &tmp, &tmp);
+        if ( max < base || max > base + 0xff )
+            continue;
+
+        add_range(cpuid_fn, base, max);
+
+        /* Xen's time leaf has subleaves 1 and 2, with no documented max. */
+        if ( is_xen_base(cpuid_fn, base) && max >= base + 3 )
+        {
+            add_leaf(base + 3, 1);
+            add_leaf(base + 3, 2);
+        }
+    }
+
+    cpuid_fn(0x80000000, 0, &max, &tmp, &tmp, &tmp);
+    if ( (max >> 16) == 0x8000 )
+        add_range(cpuid_fn, 0x80000000, min(max, 0x8000ffffu));
+}
+
+static uint32_t time_cpuid(cpuid_count_fn_t cpuid_fn, const struct leaf *l)
+{
+    uint32_t eax, ebx, ecx, edx;
+    uint64_t start, cycles;
+
+    start = rdtsc_ordered();
+    for ( unsigned int i = 0; i < ITERS; ++i )
+        cpuid_fn(l->leaf, l->subleaf, &eax, &ebx, &ecx, &edx);
+    cycles = rdtsc_ordered() - start;
+
+    divmod64(&cycles, ITERS);
+
+    return cycles;
+}
+
+/*
+ * Execute @p iters CPUIDs of user_leaf/user_subleaf in userspace, recovering
+ * from faults, and leave the elapsed cycles in user_cycles.  Only inline
+ * code may be used, as nothing outside of the user sections is accessible.
+ *
+ * @returns the exinfo of the final fault, or 0 if none occurred.
+ */
+static unsigned long __user_text user_cpuid(unsigned long iters)
+{
+    unsigned long fault = 0, a, c;
+    uint32_t lo, hi;
+    uint64_t start;
+
+    asm volatile ("lfence; rdtsc" : "=a" (lo), "=d" (hi));
+    start = ((uint64_t)hi << 32) | lo;
+
+    for ( unsigned long i = 0; i < iters; ++i )
+        asm volatile ("1: cpuid; 2:"
+                      _ASM_EXTABLE_HANDLER(1b, 2b, %P[rec])
+                      : "=a" (a), "=c" (c), "+D" (fault)
+                      : "0" (user_leaf), "1" (user_subleaf),
+                        [rec] "p" (ex_record_fault_edi)
+                      : "ebx", "edx");
+
+    asm volatile ("lfence; rdtsc" : "=a" (lo), "=d" (hi));
+    user_cycles = (((uint64_t)hi << 32) | lo) - start;
+
+    return fault;
+}
+
+/*
+ * Time faulting CPUIDs of @p l from userspace.  Returns the average cycles
+ * per CPUID, or -1 if the CPUIDs didn't fault.
+ */
+static uint32_t time_faulting(const struct leaf *l)
+{
+    uint64_t cycles;
+
+    user_leaf = l->leaf;
+    user_subleaf = l->subleaf;
+
+    if ( exec_user_param(user_cpuid, ITERS) != EXINFO_SYM(GP, 0) )
+        return -1;
+
+    cycles = user_cycles;
+    divmod64(&cycles, ITERS);
+
+    return cycles;
+}
+
+/*
+ * Enable CPUID Faulting.  Returns false if it is unavailable, leaving the
+ * previous MSR_INTEL_MISC_FEATURES_ENABLES in @p old otherwise.
+ */
+static bool enable_faulting(uint64_t *old)
+{
+    uint64_t platform_info;
+
+    if ( rdmsr_safe(MSR_INTEL_PLATFORM_INFO, &platform_info) ||
+         !(platform_info & PLATFORM_INFO_CPUID_FAULTING) ||
+         rdmsr_safe(MSR_INTEL_MISC_FEATURES_ENABLES, old) )
+        return false;
+
+    return !wrmsr_safe(MSR_INTEL_MISC_FEATURES_ENABLES,
+                       *old | MISC_FEATURES_CPUID_FAULTING);
+}
+
+static void print_cost(bool applicable, uint32_t cycles)
+{
+    if ( !applicable )
+        printk(" %9s", "-");
+    else if ( cycles == -1u )
+        printk(" %9s", "no fault");
+    else
+        printk(" %9u", cycles);
+}
+
+void test_main(void)
+{
+    bool fep = IS_DEFINED(CONFIG_PV) || xtf_has_fep, faulting;
+    uint64_t features_enable;
+
+    collect_leaves(IS_DEFINED(CONFIG_PV) ? pv_cpuid_count : cpuid_count);
+
+    if ( nr_leaves == ARRAY_SIZE(leaves) )
+        printk("Only the first %u leaves measured\n", nr_leaves);
+
+    for ( unsigned int i = 0; i < nr_leaves; ++i )
+    {
+        leaves[i].native = time_cpuid(cpuid_count, &leaves[i]);
+        if ( fep )
+            leaves[i].fep = time_cpuid(pv_cpuid_count, &leaves[i]);
+    }
+
+    faulting = enable_faulting(&features_enable);
+    if ( faulting )
+    {
+        for ( unsigned int i = 0; i < nr_leaves; ++i )
+            leaves[i].faulting = time_faulting(&leaves[i]);
+
+        if ( wrmsr_safe(MSR_INTEL_MISC_FEATURES_ENABLES, features_enable) )
+            return xtf_error("Error: Unable to disable CPUID Faulting\n");
+    }
+
+    if ( !fep )
+        printk("FEP not available\n");
+    if ( !faulting )
+        printk("CPUID Faulting not available\n");
+
+    printk("Cycles per CPUID:\n");
+    printk("  %-17s %9s %9s %9s\n", "Leaf", "Native", "FEP", "Faulting");
+
+    for ( unsigned int i = 0; i < nr_leaves; ++i )
+    {
+        const struct leaf *l = &leaves[i];
+
+        printk("  %08x:%08x", l->leaf, l->subleaf);
+        print_cost(true, l->native);
+        print_cost(fep, l->fep);
+        print_cost(faulting, l->faulting);
+        printk("\n");
+    }
+
+    xtf_success(NULL);
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
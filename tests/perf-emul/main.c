@@ -0,0 +1,177 @@
+/**
+ * @file tests/perf-emul/main.c
+ * @ref test-perf-emul
+ *
+ * @page test-perf-emul Instruction emulator throughput
+ *
+ * Execute a catalogue of instructions natively, and via the Forced Emulation
+ * Prefix so they are completed by Xen's x86 instruction emulator, and report
+ * the cost of each, and the ratio between the two.  The emulator is on the
+ * path of every MMIO access which isn't accelerated, so regressions in its
+ * throughput show up here as numbers.
+ *
+ * The catalogue covers:
+ * - ALU operations, on registers and memory, including locked operations.
+ * - Plain loads and stores.
+ * - String operations, including `rep movsb` and `rep stosb` at varying
+ *   counts.
+ * - A segment load, `invlpg`, `lgdt` and `sgdt`.
+ * - x87 and SSE loads and stores.
+ *
+ * Each instruction is executed @ref ITERS times, from a stub called in a
+ * loop.  The average number of TSC cycles per stub is reported, so includes
+ * the call overhead, shown by `nop`.  Requires FEP, so Xen must be booted with
+ * `hvm_fep`.
+ *
+ * @see tests/perf-emul/main.c
+ */
+#include <xtf.h>
+
+#include <arch/div.h>
+
+const char test_title[] = "Instruction emulator throughput";
+
+bool test_needs_fep = true;
+
+#define ITERS 1000
+
+static uint8_t src[PAGE_SIZE], dst[PAGE_SIZE];
+static uint32_t scratch;
+static uint64_t fp_val;
+static uint8_t vec[16] __aligned(16);
+
+/*
+ * Define a stub @p name, executing @p setup, then @p insn, then @p post.
+ * All registers and memory operands the catalogue uses are provided, with
+ * `%ecx` holding the stub's count, and `%esi`/`%edi` pointing at src[] and
+ * dst[].  The test is built without SSE, so `%xmm0` needn't be clobbered.
+ */
+#define STUB(name, setup, insn, post)                                   \
+    static void name(unsigned long count)                               \
+    {                                                                   \
+        unsigned long a = 0, c = count, d = 0;                          \
+        void *s = src, *di = dst;                                       \
+                                                                        \
+        asm volatile (setup insn post                                   \
+                      : "+a" (a), "+c" (c), "+d" (d), "+S" (s),         \
+                        "+D" (di), [mem] "+m" (scratch),                \
+                        [fp] "+m" (fp_val), [vec] "+m" (vec)            \
+                      : [gdt] "m" (gdt_ptr)                             \
+                      : "memory");                                      \
+    }
+
+/* Define native_@p name and fep_@p name stubs.  See STUB(). */
+#define INSN(name, setup, insn, post)                                   \
+    STUB(native_ ## name, setup, insn, post)                            \
+    STUB(fep_ ## name, setup _ASM_XEN_FEP, insn, post)
+
+INSN(nop,        "",                "nop",                         "")
+INSN(add_reg,    "",                "add %%edx, %%eax",            "")
+INSN(add_mem,    "",                "add %%eax, %[mem]",           "")
+INSN(lock_add,   "",                "lock add %%eax, %[mem]",      "")
+INSN(xchg,       "",                "xchg %%eax, %[mem]",          "")
+INSN(cmpxchg,    "",                "lock cmpxchg %%edx, %[mem]",  "")
+INSN(load,       "",                "mov %[mem], %%eax",           "")
+INSN(store,      "",                "mov %%eax, %[mem]",           "")
+INSN(movsb,      "",                "movsb",                       "")
+INSN(rep_movsb,  "",                "rep movsb",                   "")
+INSN(rep_stosb,  "",                "rep stosb",                   "")
+INSN(mov_sreg,   "mov %%ds, %%dx;", "mov %%dx, %%es",              "")
+INSN(invlpg,     "",                "invlpg %[mem]",               "")
+INSN(lgdt,       "",                "lgdt %[gdt]",                 "")
+INSN(sgdt,       "",                "sgdt %[vec]",                 "")
+INSN(fnstcw,     "",                "fnstcw %[mem]",               "")
+INSN(fld,        "",                "fldl %[fp]",        "; fstp %%st(0)")
+INSN(fst,        "fldz;",           "fstl %[fp]",        "; fstp %%st(0)")
+INSN(movups_ld,  "",                "movups %[vec], %%xmm0",       "")
+INSN(movups_st,  "",                "movups %%xmm0, %[vec]",       "")
+INSN(movaps_ld,  "",                "movaps %[vec], %%xmm0",       "")
+
+static const struct insn {
+    const char *name;
+    unsigned long count;
+    void (*native)(unsigned long count);
+    void (*fep)(unsigned long count);
+} insns[] = {
+#define E(name, str, count) { str, count, native_ ## name, fep_ ## name }
+    E(nop,       "nop",                 0),
+    E(add_reg,   "add reg, reg",        0),
+    E(add_mem,   "add reg, mem",        0),
+    E(lock_add,  "lock add reg, mem",   0),
+    E(xchg,      "xchg reg, mem",       0),
+    E(cmpxchg,   "lock cmpxchg",        0),
+    E(load,      "mov mem, reg",        0),
+    E(store,     "mov reg, mem",        0),
+    E(movsb,     "movsb",               0),
+    E(rep_movsb, "rep movsb",           8),
+    E(rep_movsb, "rep movsb",           64),
+    E(rep_movsb, "rep movsb",           512),
+    E(rep_movsb, "rep movsb",           PAGE_SIZE),
+    E(rep_stosb, "rep stosb",           8),
+    E(rep_stosb, "rep stosb",           64),
+    E(rep_stosb, "rep stosb",           512),
+    E(rep_stosb, "rep stosb",           PAGE_SIZE),
+    E(mov_sreg,  "mov reg, %es",        0),
+    E(invlpg,    "invlpg",              0),
+    E(lgdt,      "lgdt",                0),
+    E(sgdt,      "sgdt",                0),
+    E(fnstcw,    "fnstcw",              0),
+    E(fld,       "fld m64 (+fstp)",     0),
+    E(fst,       "fst m64 (+fstp)",     0),
+    E(movups_ld, "movups mem, xmm",     0),
+    E(movups_st, "movups xmm, mem",     0),
+    E(movaps_ld, "movaps mem, xmm",     0),
+#undef E
+};
+
+static uint32_t measure(void (*fn)(unsigned long count), unsigned long count)
+{
+    uint64_t start, cycles;
+
+    /* Warm up. */
+    fn(count);
+
+    start = rdtsc_ordered();
+    for ( unsigned int i = 0; i < ITERS; ++i )
+        fn(count);
+    cycles = rdtsc_ordered() - start;
+
+    divmod64(&cycles, ITERS);
+
+    return cycles;
+}
+
+void test_main(void)
+{
+    /* Enable the FPU and SSE for the x87 and SSE entries. */
+    write_cr0(read_cr0() & ~X86_CR0_TS);
+    write_cr4(read_cr4() | X86_CR4_OSFXSR | X86_CR4_OSXMMEXCPT);
+    asm volatile ("fninit");
+
+    printk("Cycles per instruction:\n");
+    printk("  %-20s %5s %9s %9s %9s\n", "Instruction", "Count",
+           "Native", "Emulated", "Ratio");
+
+    for ( unsigned int i = 0; i < ARRAY_SIZE(insns); ++i )
+    {
+        const struct insn *in = &insns[i];
+        uint32_t native = measure(in->native, in->count);
+        uint32_t fep = measure(in->fep, in->count);
+        uint32_t ratio = native ? (fep * 100 + native / 2) / native : 0;
+
+        printk("  %-20s %5lu %9u %9u %6u.%02u\n", in->name, in->count,
+               native, fep, ratio / 100, ratio % 100);
+    }
+
+    xtf_success(NULL);
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
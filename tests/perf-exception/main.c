@@ -0,0 +1,156 @@
+/**
+ * @file tests/perf-exception/main.c
+ * @ref test-perf-exception
+ *
+ * @page test-perf-exception Exception delivery cost
+ *
+ * Measure the round trip cost of exceptions raised and recovered from in the
+ * kernel, for:
+ *
+ * - @#UD: `ud2`.
+ * - @#GP: Loading an LDT selector into `%%es`, with no LDT.
+ * - @#PF: Reading from the unmapped NULL page (not in unpaged environments).
+ * - @#DB: `icebp`.
+ * - @#BP: `int3`.
+ *
+ * Each is recovered from in two ways:
+ *
+ * - `Extable`: The regular exception table, via `do_exception()`,
+ *   `search_extable()` and ex_record_fault_eax().
+ * - `Fast`: The fast exception table (@ref _ASM_EXTABLE_FAST), recovered
+ *   from in the assembly entry path without calling into C.
+ *
+ * The difference between the two is the cost of XTF's own exception
+ * handling, and the remainder is the cost of delivery, which for PV guests
+ * includes bouncing the exception through Xen.  The average number of TSC
+ * cycles per exception, over @ref ITERS exceptions, is reported.
+ *
+ * @see tests/perf-exception/main.c
+ */
+#include <xtf.h>
+
+#include <arch/div.h>
+
+const char test_title[] = "Exception delivery cost";
+
+#define ITERS 1000
+
+/* An LDT selector.  No LDT is loaded, so loading it yields @#GP. */
+#define LDT_SEL 0x4
+
+/*
+ * Define name_slow() and name_fast(), executing @p insn and returning the
+ * exinfo recorded.  @p at is the address the exception reports: 1b for
+ * faults, 2b for traps.
+ */
+#define STUBS(name, insn, at)                                           \
+    static exinfo_t name ## _slow(void)                                 \
+    {                                                                   \
+        exinfo_t ex = 0;                                                \
+                                                                        \
+        asm volatile ("1: " insn "; 2:"                                 \
+                      _ASM_EXTABLE_HANDLER(at, 2b, %P[rec])             \
+                      : "+a" (ex)                                       \
+                      : [sel] "r" (LDT_SEL),                            \
+                        [rec] "p" (ex_record_fault_eax));               \
+        return ex;                                                      \
+    }                                                                   \
+    static exinfo_t name ## _fast(void)                                 \
+    {                                                                   \
+        exinfo_t ex = 0;                                                \
+                                                                        \
+        asm volatile ("1: " insn "; 2:"                                 \
+                      _ASM_EXTABLE_FAST(at, 2b)                         \
+                      : "+a" (ex)                                       \
+                      : [sel] "r" (LDT_SEL));                           \
+        return ex;                                                      \
+    }
+
+STUBS(ud, "ud2",                 1b)
+STUBS(gp, "mov %[sel], %%es",    1b)
+#if CONFIG_PAGING_LEVELS > 0 /* NULL is mapped without paging. */
+STUBS(pf, "cmpb $0, 0",          1b)
+#endif
+STUBS(db, ".byte 0xf1",          2b) /* icebp */
+STUBS(bp, "int3",                2b)
+
+static const struct exc {
+    const char *name;
+    unsigned int vec;
+    exinfo_t (*slow)(void);
+    exinfo_t (*fast)(void);
+} excs[] = {
+#define E(name, vec) { #vec, X86_EXC_ ## vec, name ## _slow, name ## _fast }
+    E(ud, UD),
+    E(gp, GP),
+#if CONFIG_PAGING_LEVELS > 0
+    E(pf, PF),
+#endif
+    E(db, DB),
+    E(bp, BP),
+#undef E
+};
+
+/*
+ * Time ITERS exceptions from @p fn.  Returns the average cycles per
+ * exception, or -1 if @p fn didn't raise @p vec.
+ */
+static uint32_t measure(exinfo_t (*fn)(void), unsigned int vec)
+{
+    uint64_t start, cycles;
+    exinfo_t ex = fn();
+
+    if ( !ex || exinfo_vec(ex) != vec )
+    {
+        xtf_failure("Fail: Expected vector %u, got %pe\n", vec, _p(ex));
+        return -1;
+    }
+
+    start = rdtsc_ordered();
+    for ( unsigned int i = 0; i < ITERS; ++i )
+        fn();
+    cycles = rdtsc_ordered() - start;
+
+    divmod64(&cycles, ITERS);
+
+    return cycles;
+}
+
+static void print_cost(uint32_t cycles)
+{
+    if ( cycles == -1u )
+        printk(" %10s", "-");
+    else
+        printk(" %10u", cycles);
+}
+
+void test_main(void)
+{
+    printk("Cycles per exception:\n");
+    printk("  %-6s %10s %10s\n", "Vector", "Extable", "Fast");
+
+    for ( unsigned int i = 0; i < ARRAY_SIZE(excs); ++i )
+    {
+        const struct exc *e = &excs[i];
+
+        printk("  %-6s", e->name);
+        print_cost(measure(e->slow, e->vec));
+        print_cost(measure(e->fast, e->vec));
+        printk("\n");
+    }
+
+    if ( xtf_status_reported() )
+        return;
+
+    xtf_success(NULL);
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
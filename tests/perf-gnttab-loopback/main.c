@@ -0,0 +1,486 @@
+/**
+ * @file tests/perf-gnttab-loopback/main.c
+ * @ref test-perf-gnttab-loopback
+ *
+ * @page test-perf-gnttab-loopback Grant loopback data path
+ *
+ * Measure a split-driver style data path, with the frontend and backend both
+ * inside the test domain, connected by grants to itself.
+ *
+ * The frontend grants a ring page, and pages of request data, to its own
+ * domain.  The backend maps the ring through its grant, so each end accesses
+ * the ring through its own mapping, as between two domains.  The ring holds
+ * @ref RING_SIZE requests and responses, with free-running producer and
+ * consumer indices, in the style of the xenbus ring.  The two ends notify
+ * each other over a loopback interdomain event channel, and the backend runs
+ * in its event channel handler.
+ *
+ * Each request carries up to @ref MAX_SEGS grant references, for a request
+ * size of 512 bytes to 32k.  The backend moves the data into its own buffer
+ * either by:
+ *
+ * - `map`: Map the request's grants read-only in a single
+ *   `GNTTABOP_map_grant_ref`, `memcpy()` the data, and unmap.
+ * - `copy`: A single `GNTTABOP_copy`, with one operation per segment.
+ *
+ * The frontend keeps the ring full for @ref OPS requests.  Throughput is
+ * reported in MB/s, and latency (from the frontend producing a request to
+ * consuming its response) in nanoseconds, at the 50th and 99th percentiles,
+ * and the maximum.
+ *
+ * @see tests/perf-gnttab-loopback/main.c
+ */
+#include <xtf.h>
+
+#include <arch/div.h>
+
+const char test_title[] = "Grant loopback data path";
+
+#define RING_SIZE 8
+#define MAX_SEGS  8
+#define OPS       512
+
+struct loop_req {
+    uint32_t id;
+    uint32_t len;               /* Bytes, across all segments. */
+    grant_ref_t gref[MAX_SEGS];
+};
+
+struct loop_rsp {
+    uint32_t id;
+    int32_t status;             /* 0, or -errno. */
+};
+
+struct loop_ring {
+    struct loop_req req[RING_SIZE];
+    struct loop_rsp rsp[RING_SIZE];
+    uint32_t req_prod, req_cons;
+    uint32_t rsp_prod, rsp_cons;
+};
+
+static unsigned int mask_idx(uint32_t idx)
+{
+    return idx & (RING_SIZE - 1);
+}
+
+enum mode {
+    MODE_MAP,
+    MODE_COPY,
+};
+
+static const char *const mode_names[] = {
+    [MODE_MAP]  = "map",
+    [MODE_COPY] = "copy",
+};
+
+static const unsigned int req_sizes[] = {
+    512, PAGE_SIZE, 4 * PAGE_SIZE, MAX_SEGS * PAGE_SIZE,
+};
+
+/* Frontend state. */
+static struct loop_ring front_ring __page_aligned_bss;
+static uint8_t front_data[RING_SIZE * MAX_SEGS * PAGE_SIZE] __page_aligned_bss;
+static grant_ref_t ring_ref, data_refs[RING_SIZE * MAX_SEGS];
+static evtchn_port_t front_port;
+static uint64_t submitted[RING_SIZE]; /* Indexed by request id. */
+static uint32_t lat[OPS];
+
+/* Backend state. */
+#if defined(CONFIG_PV)
+static uint8_t back_window[(1 + RING_SIZE * MAX_SEGS) * PAGE_SIZE]
+    __page_aligned_bss;
+#else
+/* Beyond the end of the l1_identmap[] which the test must fit within. */
+static uint8_t *const back_window = _p(MB(8));
+#endif
+static uint8_t back_data[RING_SIZE * MAX_SEGS * PAGE_SIZE] __page_aligned_bss;
+static struct loop_ring *back_ring;
+static grant_handle_t ring_handle;
+static evtchn_port_t back_port;
+static enum mode back_mode;
+static unsigned int back_errors;
+
+static struct gnttab_map_grant_ref maps[MAX_SEGS];
+static struct gnttab_unmap_grant_ref unmaps[MAX_SEGS];
+static struct gnttab_copy copies[MAX_SEGS];
+
+static domid_t domid;
+
+static uint64_t host_addr(const void *va)
+{
+    /* PV guests map at a linear address, HVM guests at a physical one. */
+    if ( IS_DEFINED(CONFIG_PV) )
+        return _u(va);
+    else
+        return (uint64_t)virt_to_gfn(va) << PAGE_SHIFT;
+}
+
+/* Backend: the ring slot's segment @p seg. */
+static void *back_seg(unsigned int slot, unsigned int seg)
+{
+    return &back_window[(1 + slot * MAX_SEGS + seg) * PAGE_SIZE];
+}
+
+static unsigned int nr_segs(uint32_t len)
+{
+    return (len + PAGE_SIZE - 1) / PAGE_SIZE;
+}
+
+static unsigned int seg_len(uint32_t len, unsigned int seg)
+{
+    uint32_t left = len - seg * PAGE_SIZE;
+
+    return min(left, (uint32_t)PAGE_SIZE);
+}
+
+/* Backend: move one request's data into back_data[]. */
+static int back_handle_req(unsigned int slot, const struct loop_req *req)
+{
+    unsigned int segs = nr_segs(req->len), i;
+    uint8_t *dst = &back_data[slot * MAX_SEGS * PAGE_SIZE];
+    int rc;
+
+    if ( !segs || segs > MAX_SEGS )
+        return -EINVAL;
+
+    switch ( back_mode )
+    {
+    case MODE_MAP:
+        for ( i = 0; i < segs; ++i )
+            maps[i] = (struct gnttab_map_grant_ref){
+                .host_addr = host_addr(back_seg(slot, i)),
+                .flags = GNTMAP_host_map | GNTMAP_readonly,
+                .ref = req->gref[i],
+                .dom = domid,
+            };
+
+        rc = gnttab_batch_map(maps, segs);
+        if ( rc )
+            return rc;
+
+        for ( i = 0; i < segs; ++i )
+        {
+            memcpy(dst + i * PAGE_SIZE, back_seg(slot, i),
+                   seg_len(req->len, i));
+
+            unmaps[i] = (struct gnttab_unmap_grant_ref){
+                .host_addr = maps[i].host_addr,
+                .handle = maps[i].handle,
+            };
+        }
+
+        rc = gnttab_batch_unmap(unmaps, segs);
+        break;
+
+    case MODE_COPY:
+        for ( i = 0; i < segs; ++i )
+            copies[i] = (struct gnttab_copy){
+                .source = {
+                    .u.ref = req->gref[i],
+                    .domid = domid,
+                },
+                .dest = {
+                    .u.gmfn = virt_to_gfn(dst + i * PAGE_SIZE),
+                    .domid = domid,
+                },
+                .len = seg_len(req->len, i),
+                .flags = GNTCOPY_source_gref,
+            };
+
+        rc = gnttab_batch_copy(copies, segs);
+        break;
+
+    default:
+        return -EINVAL;
+    }
+
+    if ( rc )
+        return rc;
+
+    /* The frontend tags each segment with the request id. */
+    for ( i = 0; i < segs; ++i )
+        if ( *(uint32_t *)(dst + i * PAGE_SIZE) != req->id )
+            return -EIO;
+
+    return 0;
+}
+
+/* Backend: consume all requests, and respond to them. */
+static void back_event(evtchn_port_t port, void *data)
+{
+    uint32_t cons = back_ring->req_cons, prod, rsp_prod;
+
+    prod = ACCESS_ONCE(back_ring->req_prod);
+    smp_rmb(); /* Read requests after observing the producer index. */
+
+    if ( cons == prod )
+        return;
+
+    rsp_prod = back_ring->rsp_prod;
+
+    for ( ; cons != prod; ++cons, ++rsp_prod )
+    {
+        unsigned int slot = mask_idx(cons);
+        struct loop_req req = back_ring->req[slot];
+        int rc = back_handle_req(slot, &req);
+
+        if ( rc )
+            back_errors++;
+
+        back_ring->rsp[mask_idx(rsp_prod)] = (struct loop_rsp){
+            .id = req.id,
+            .status = rc,
+        };
+    }
+
+    ACCESS_ONCE(back_ring->req_cons) = cons;
+
+    smp_wmb(); /* Write responses before updating the producer index. */
+    ACCESS_ONCE(back_ring->rsp_prod) = rsp_prod;
+
+    evtchn_send(back_port);
+}
+
+/* Frontend: responses are consumed by the submission loop. */
+static void front_event(evtchn_port_t port, void *data)
+{
+}
+
+/* Frontend: produce a request for @p id, in ring slot mask_idx(@p prod). */
+static void front_produce(uint32_t prod, uint32_t id, uint32_t len)
+{
+    unsigned int slot = mask_idx(prod);
+    struct loop_req *req = &front_ring.req[slot];
+
+    req->id = id;
+    req->len = len;
+
+    for ( unsigned int i = 0; i < nr_segs(len); ++i )
+    {
+        unsigned int idx = slot * MAX_SEGS + i;
+
+        *(uint32_t *)&front_data[idx * PAGE_SIZE] = id;
+        req->gref[i] = data_refs[idx];
+    }
+
+    submitted[mask_idx(id)] = xen_system_time();
+}
+
+/*
+ * Frontend: Keep the ring full until OPS requests have completed.  Returns
+ * elapsed time in ns, or 0 on error.
+ */
+static uint64_t run(uint32_t len)
+{
+    uint32_t prod = front_ring.req_prod, cons = front_ring.rsp_cons;
+    uint32_t sent = 0, done = 0;
+    uint64_t start = xen_system_time();
+
+    while ( done < OPS )
+    {
+        uint32_t rsp_prod;
+
+        /* Slots are free once their response has been consumed. */
+        if ( sent < OPS && prod - cons < RING_SIZE )
+        {
+            while ( sent < OPS && prod - cons < RING_SIZE )
+                front_produce(prod++, sent++, len);
+
+            smp_wmb(); /* Write requests before updating the producer. */
+            ACCESS_ONCE(front_ring.req_prod) = prod;
+
+            evtchn_send(front_port);
+        }
+
+        /* Wait for responses, with upcalls disabled to avoid missing one. */
+        for ( ;; )
+        {
+            evtchn_disable_upcalls();
+
+            rsp_prod = ACCESS_ONCE(front_ring.rsp_prod);
+            if ( rsp_prod != cons )
+                break;
+
+            evtchn_block();
+        }
+        evtchn_enable_upcalls();
+
+        smp_rmb(); /* Read responses after observing the producer index. */
+
+        for ( ; cons != rsp_prod; ++cons )
+        {
+            const struct loop_rsp *rsp = &front_ring.rsp[mask_idx(cons)];
+            uint64_t now = xen_system_time();
+
+            if ( rsp->status )
+            {
+                xtf_error("Error: Request %u failed: %d\n",
+                          rsp->id, rsp->status);
+                return 0;
+            }
+
+            lat[done++] = now - submitted[mask_idx(rsp->id)];
+        }
+
+        ACCESS_ONCE(front_ring.rsp_cons) = cons;
+    }
+
+    return xen_system_time() - start;
+}
+
+static int cmp_u32(const void *_l, const void *_r)
+{
+    uint32_t l = *(const uint32_t *)_l, r = *(const uint32_t *)_r;
+
+    return (l > r) - (l < r);
+}
+
+static void swap_u32(void *_l, void *_r)
+{
+    uint32_t *l = _l, *r = _r, tmp = *l;
+
+    *l = *r;
+    *r = tmp;
+}
+
+static void print_result(uint32_t len, uint64_t elapsed)
+{
+    uint64_t bytes = (uint64_t)len * OPS;
+
+    /* Bytes per us is MB/s.  Elapsed time in us fits in 32 bits. */
+    divmod64(&elapsed, 1000);
+    divmod64(&bytes, elapsed ?: 1);
+
+    heapsort(lat, OPS, sizeof(*lat), cmp_u32, swap_u32);
+
+    printk("  %6u %8"PRIu64" %9u %9u %9u\n", len, bytes,
+           lat[OPS / 2], lat[OPS * 99 / 100], lat[OPS - 1]);
+}
+
+static bool connect(void)
+{
+    struct gnttab_map_grant_ref map;
+    int rc;
+
+    BUILD_BUG_ON(sizeof(struct loop_ring) > PAGE_SIZE);
+
+    rc = gnttab_grant_access(domid, virt_to_gfn(&front_ring), false,
+                             &ring_ref);
+    for ( unsigned int i = 0; !rc && i < ARRAY_SIZE(data_refs); ++i )
+        rc = gnttab_grant_access(domid,
+                                 virt_to_gfn(&front_data[i * PAGE_SIZE]),
+                                 true, &data_refs[i]);
+    if ( rc )
+    {
+        xtf_error("Error: Granting frontend pages failed: %d\n", rc);
+        return false;
+    }
+
+    /* The backend maps the ring through its grant. */
+    map = (struct gnttab_map_grant_ref){
+        .host_addr = host_addr(back_window),
+        .flags = GNTMAP_host_map,
+        .ref = ring_ref,
+        .dom = domid,
+    };
+
+    rc = gnttab_batch_map(&map, 1);
+    if ( rc )
+    {
+        xtf_error("Error: Backend mapping ring failed: %d, status %d\n",
+                  rc, map.status);
+        return false;
+    }
+
+    back_ring = (void *)back_window;
+    ring_handle = map.handle;
+
+    rc = evtchn_alloc_unbound(DOMID_SELF, &back_port) ?:
+        evtchn_bind_interdomain(DOMID_SELF, back_port, &front_port);
+    if ( rc )
+    {
+        xtf_error("Error: Binding event channels failed: %d\n", rc);
+        return false;
+    }
+
+    evtchn_set_handler(back_port, back_event, NULL);
+    evtchn_set_handler(front_port, front_event, NULL);
+
+    return true;
+}
+
+static void disconnect(void)
+{
+    struct gnttab_unmap_grant_ref unmap = {
+        .host_addr = host_addr(back_window),
+        .handle = ring_handle,
+    };
+
+    evtchn_close(front_port);
+    evtchn_close(back_port);
+
+    if ( gnttab_batch_unmap(&unmap, 1) )
+        xtf_error("Error: Backend unmapping ring failed: %d\n", unmap.status);
+
+    for ( unsigned int i = 0; i < ARRAY_SIZE(data_refs); ++i )
+        gnttab_end_access(data_refs[i]);
+    gnttab_end_access(ring_ref);
+}
+
+void test_main(void)
+{
+    int rc = xtf_get_domid();
+
+    if ( rc < 0 )
+        return xtf_error("Error getting domid\n");
+
+    domid = rc;
+
+    rc = evtchn_init() ?: xtf_init_grant_table(1);
+    if ( rc )
+        return xtf_error("Error initialising: %d\n", rc);
+
+    if ( !connect() )
+        return;
+
+    for ( unsigned int m = 0; m < ARRAY_SIZE(mode_names); ++m )
+    {
+        back_mode = m;
+
+        printk("Mode: %s\n", mode_names[m]);
+        printk("  %6s %8s %9s %9s %9s\n",
+               "Size", "MB/s", "p50 ns", "p99 ns", "Max ns");
+
+        for ( unsigned int s = 0; s < ARRAY_SIZE(req_sizes); ++s )
+        {
+            uint64_t elapsed = run(req_sizes[s]);
+
+            if ( !elapsed )
+                goto out;
+
+            print_result(req_sizes[s], elapsed);
+        }
+    }
+
+ out:
+    evtchn_disable_upcalls();
+    disconnect();
+
+    if ( back_errors )
+        xtf_failure("Fail: Backend saw %u bad requests\n", back_errors);
+
+    if ( xtf_status_reported() )
+        return;
+
+    xtf_success(NULL);
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
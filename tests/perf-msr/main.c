@@ -0,0 +1,174 @@
+/**
+ * @file tests/perf-msr/main.c
+ * @ref test-perf-msr
+ *
+ * @page test-perf-msr MSR access cost
+ *
+ * Measure the cost of `rdmsr` and `wrmsr` for a selection of MSRs, both
+ * executed directly (and intercepted by Xen, unless the MSR is passed
+ * through), and via the Forced Emulation Prefix (taking Xen's instruction
+ * emulator path).  The difference between the two, and between MSRs, shows
+ * which MSRs hit slow paths in Xen's MSR handling.
+ *
+ * Writes write back the value read, so don't change state.  Write-only MSRs
+ * are written with 0.  Some MSRs are only read, as writing them would perturb
+ * the test (e.g. `MSR_TSC`).
+ *
+ * HVM guests switch the local APIC into x2APIC mode, if available, for the
+ * x2APIC MSRs.  The FEP columns are only available if Xen was booted with
+ * `hvm_fep` (which also covers PV guests).
+ *
+ * The average number of TSC cycles per access, over @ref ITERS accesses, is
+ * reported.  MSRs which fault are reported as `#GP`, and accesses which
+ * weren't attempted (e.g. writes to MSRs whose read faulted) as `-`.
+ *
+ * @see tests/perf-msr/main.c
+ */
+#include <xtf.h>
+
+#include <arch/div.h>
+
+const char test_title[] = "MSR access cost";
+
+#define ITERS 1000
+
+#define X2APIC_MSR(reg) (MSR_X2APIC_REGS + ((reg) >> 4))
+
+#define MSR_RD 0x1
+#define MSR_WR 0x2
+#define MSR_RW (MSR_RD | MSR_WR)
+
+static const struct msr {
+    uint32_t idx;
+    const char *name;
+    unsigned int flags;
+} msrs[] = {
+    { MSR_TSC,                 "TSC",            MSR_RD },
+    { MSR_APICBASE,            "APICBASE",       MSR_RW },
+    { MSR_SPEC_CTRL,           "SPEC_CTRL",      MSR_RW },
+    { MSR_PRED_CMD,            "PRED_CMD",       MSR_WR },
+    { MSR_MISC_ENABLE,         "MISC_ENABLE",    MSR_RD },
+    { MSR_DEBUGCTL,            "DEBUGCTL",       MSR_RW },
+    { MSR_PAT,                 "PAT",            MSR_RW },
+    { MSR_TSC_DEADLINE,        "TSC_DEADLINE",   MSR_RW },
+    { X2APIC_MSR(APIC_ID),     "x2APIC ID",      MSR_RD },
+    { X2APIC_MSR(APIC_LVR),    "x2APIC LVR",     MSR_RD },
+    { X2APIC_MSR(APIC_TASKPRI), "x2APIC TPR",    MSR_RW },
+    { X2APIC_MSR(APIC_SPIV),   "x2APIC SPIV",    MSR_RW },
+    { X2APIC_MSR(APIC_LVTT),   "x2APIC LVTT",    MSR_RW },
+    { X2APIC_MSR(APIC_TMICT),  "x2APIC TMICT",   MSR_RW },
+    { X2APIC_MSR(APIC_TMCCT),  "x2APIC TMCCT",   MSR_RD },
+    { MSR_EFER,                "EFER",           MSR_RW },
+    { MSR_STAR,                "STAR",           MSR_RW },
+    { MSR_LSTAR,               "LSTAR",          MSR_RW },
+    { MSR_FS_BASE,             "FS_BASE",        MSR_RW },
+    { MSR_GS_BASE,             "GS_BASE",        MSR_RW },
+    { MSR_SHADOW_GS_BASE,      "SHADOW_GS_BASE", MSR_RW },
+    { MSR_TSC_AUX,             "TSC_AUX",        MSR_RW },
+};
+
+/*
+ * Time ITERS reads of @p idx.  Returns the average cycles per read, or -1
+ * if the read faults.
+ */
+static uint32_t time_read(uint32_t idx, bool fep)
+{
+    bool (*rd)(uint32_t idx, uint64_t *val) =
+        fep ? rdmsr_fep_safe : rdmsr_safe;
+    uint64_t val, start, cycles;
+
+    if ( rd(idx, &val) )
+        return -1;
+
+    start = rdtsc_ordered();
+    for ( unsigned int i = 0; i < ITERS; ++i )
+        rd(idx, &val);
+    cycles = rdtsc_ordered() - start;
+
+    divmod64(&cycles, ITERS);
+
+    return cycles;
+}
+
+/*
+ * Time ITERS writes of @p val to @p idx.  Returns the average cycles per
+ * write, or -1 if the write faults.
+ */
+static uint32_t time_write(uint32_t idx, uint64_t val, bool fep)
+{
+    bool (*wr)(uint32_t idx, uint64_t val) =
+        fep ? wrmsr_fep_safe : wrmsr_safe;
+    uint64_t start, cycles;
+
+    if ( wr(idx, val) )
+        return -1;
+
+    start = rdtsc_ordered();
+    for ( unsigned int i = 0; i < ITERS; ++i )
+        wr(idx, val);
+    cycles = rdtsc_ordered() - start;
+
+    divmod64(&cycles, ITERS);
+
+    return cycles;
+}
+
+static void print_cost(bool applicable, uint32_t cycles)
+{
+    if ( !applicable )
+        printk(" %10s", "-");
+    else if ( cycles == -1u )
+        printk(" %10s", "#GP");
+    else
+        printk(" %10u", cycles);
+}
+
+static void survey(const struct msr *m)
+{
+    bool rd = m->flags & MSR_RD, wr = m->flags & MSR_WR, fep = xtf_has_fep;
+    bool readable = true;
+    uint64_t val = 0;
+
+    /* Write back the current value.  Don't write MSRs which can't be read. */
+    if ( rd )
+        readable = !rdmsr_safe(m->idx, &val);
+
+    printk("  %08x %-14s", m->idx, m->name);
+
+    print_cost(rd, rd ? time_read(m->idx, false) : 0);
+    print_cost(rd && fep, rd && fep ? time_read(m->idx, true) : 0);
+    print_cost(wr && readable,
+               wr && readable ? time_write(m->idx, val, false) : 0);
+    print_cost(wr && fep && readable,
+               wr && fep && readable ? time_write(m->idx, val, true) : 0);
+
+    printk("\n");
+}
+
+void test_main(void)
+{
+    if ( IS_DEFINED(CONFIG_HVM) && apic_init(APIC_MODE_X2APIC) )
+        printk("x2APIC not available\n");
+
+    if ( !xtf_has_fep )
+        printk("FEP not available\n");
+
+    printk("Cycles per access:\n");
+    printk("  %-8s %-14s %10s %10s %10s %10s\n", "MSR", "Name",
+           "Read", "FEP read", "Write", "FEP write");
+
+    for ( unsigned int i = 0; i < ARRAY_SIZE(msrs); ++i )
+        survey(&msrs[i]);
+
+    xtf_success(NULL);
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,185 @@
+/**
+ * @file tests/perf-nested-svm/main.c
+ * @ref test-perf-nested-svm
+ *
+ * @page test-perf-nested-svm Nested SVM VMRUN/#VMEXIT cost
+ *
+ * Build a VMCB for a trivial L2 guest which executes `vmmcall` in a loop, and
+ * measure the round trip of `vmrun`, the intercepted `vmmcall`, and the
+ * @#VMEXIT back to L1, in TSC cycles.  The guest's `%rip` is not advanced, so
+ * each `vmrun` executes the same instruction.  Variants:
+ *
+ * - `No clean bits`: The VMCB clean field is 0 for every `vmrun`, so L0 must
+ *   assume all VMCB state changed.
+ * - `Clean bits`: All clean bits are set after the first `vmrun`.  Only
+ *   meaningful if L0 offers VMCB Clean Bits to L1.
+ * - `Nested paging`: As `Clean bits`, with L1 nested paging enabled for L2,
+ *   using an identity map.  Only available in 64bit environments.
+ * - `vmload/vmsave`: As `Clean bits`, with the host/guest `vmsave`/`vmload`
+ *   pairs a hypervisor uses to switch FS, GS, TR, LDTR and the syscall MSRs.
+ *
+ * The cost of a lone `vmload` and `vmsave` by L1 is also reported.  Averages
+ * are taken over @ref ITERS operations.  Requires SVM in the guest
+ * (`nestedhvm = 1`).  Compare with @ref test-perf-nested-vmx.
+ *
+ * @see tests/perf-nested-svm/main.c
+ */
+#include <xtf.h>
+
+#include <arch/div.h>
+#include <arch/svm.h>
+
+const char test_title[] = "Nested SVM VMRUN/#VMEXIT cost";
+
+#define ITERS 1000
+
+static uint8_t hsave[PAGE_SIZE] __page_aligned_bss;
+static struct vmcb vmcb __page_aligned_bss;
+static struct vmcb host_vmcb __page_aligned_bss;
+static uint8_t guest_stack[PAGE_SIZE] __page_aligned_bss;
+
+enum variant {
+    NO_CLEAN,
+    CLEAN,
+    NPT,
+    LOAD_SAVE,
+};
+
+static const char *const variant_names[] = {
+    [NO_CLEAN]  = "No clean bits",
+    [CLEAN]     = "Clean bits",
+    [NPT]       = "Nested paging",
+    [LOAD_SAVE] = "vmload/vmsave",
+};
+
+static void __noreturn vmmcall_guest(void)
+{
+    for ( ;; )
+        asm volatile ("vmmcall");
+}
+
+static uint32_t per_iter(uint64_t cycles)
+{
+    divmod64(&cycles, ITERS);
+
+    return cycles;
+}
+
+/* Run the guest once, as variant @p v requires. */
+static void run_guest(enum variant v)
+{
+    if ( v == NO_CLEAN )
+        vmcb.clean = 0;
+
+    if ( v == LOAD_SAVE )
+    {
+        vmsave(_u(&host_vmcb));
+        vmload(_u(&vmcb));
+    }
+
+    svm_enter(&vmcb);
+
+    if ( v == LOAD_SAVE )
+    {
+        vmsave(_u(&vmcb));
+        vmload(_u(&host_vmcb));
+    }
+}
+
+static void time_round_trip(enum variant v)
+{
+    const char *name = variant_names[v];
+    uint64_t start, cycles;
+    int rc;
+
+    svm_init_vmcb(&vmcb, vmmcall_guest,
+                  &guest_stack[PAGE_SIZE - sizeof(unsigned long)]);
+
+    if ( v == NPT )
+    {
+        rc = svm_enable_npt(&vmcb);
+        if ( rc )
+            return printk("  %-24s %9s\n", name, "n/a");
+    }
+
+    /* Warm up, and check the guest exits as expected. */
+    run_guest(v);
+    if ( vmcb.exitcode != VMEXIT_VMMCALL )
+        return xtf_error("Error: %s: expected #VMEXIT %#x, got %#"PRIx64"\n",
+                         name, VMEXIT_VMMCALL, vmcb.exitcode);
+
+    if ( v != NO_CLEAN )
+        vmcb.clean = VMCB_CLEAN_ALL;
+
+    start = rdtsc_ordered();
+    for ( unsigned int i = 0; i < ITERS; ++i )
+        run_guest(v);
+    cycles = rdtsc_ordered() - start;
+
+    if ( vmcb.exitcode != VMEXIT_VMMCALL )
+        return xtf_error("Error: %s: expected #VMEXIT %#x, got %#"PRIx64"\n",
+                         name, VMEXIT_VMMCALL, vmcb.exitcode);
+
+    printk("  %-24s %9u\n", name, per_iter(cycles));
+}
+
+static void time_load_save(void)
+{
+    uint64_t start, cycles;
+
+    vmsave(_u(&host_vmcb));
+
+    start = rdtsc_ordered();
+    for ( unsigned int i = 0; i < ITERS; ++i )
+        vmsave(_u(&host_vmcb));
+    cycles = rdtsc_ordered() - start;
+    printk("  %-24s %9u\n", "vmsave", per_iter(cycles));
+
+    start = rdtsc_ordered();
+    for ( unsigned int i = 0; i < ITERS; ++i )
+        vmload(_u(&host_vmcb));
+    cycles = rdtsc_ordered() - start;
+    printk("  %-24s %9u\n", "vmload", per_iter(cycles));
+}
+
+void test_main(void)
+{
+    uint32_t eax, ebx, ecx, svm_features;
+    int rc;
+
+    if ( !cpu_has_svm )
+        return xtf_skip("Skip: SVM not available\n");
+
+    rc = svm_enable(hsave);
+    if ( rc )
+        return xtf_error("Error: svm_enable() failed: %d\n", rc);
+
+    cpuid(0x8000000a, &eax, &ebx, &ecx, &svm_features);
+
+    if ( !(svm_features & SVM_FEATURE_VMCB_CLEAN) )
+        printk("VMCB Clean Bits not available\n");
+    if ( !(svm_features & SVM_FEATURE_NPT) )
+        printk("Nested paging not available\n");
+
+    printk("Cycles per operation:\n");
+
+    for ( unsigned int v = 0; v < ARRAY_SIZE(variant_names); ++v )
+        if ( !xtf_status_reported() )
+            time_round_trip(v);
+
+    time_load_save();
+
+    svm_disable();
+
+    xtf_success(NULL);
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,256 @@
+/**
+ * @file tests/perf-nested-vmx/main.c
+ * @ref test-perf-nested-vmx
+ *
+ * @page test-perf-nested-vmx Nested VT-x entry/exit and VMCS access cost
+ *
+ * Build a VMCS for a trivial L2 guest, and measure, in TSC cycles:
+ *
+ * - The round trip of `vmresume`, an L2 `vmcall` or `cpuid`, and the VM exit
+ *   back to L1.  The guest's `%rip` is not advanced, so each entry executes
+ *   the same instruction.  Under nested virt, both the entry and the exit are
+ *   emulated by L0.
+ * - The same round trip via `vmlaunch`, with the `vmclear` and `vmptrld`
+ *   which are needed to make the VMCS launchable again each time.
+ * - `vmread` and `vmwrite` of the current VMCS by L1.  Whether these trap to
+ *   L0 depends on whether L0 uses VMCS shadowing for L1.
+ * - `vmread` and `vmwrite` by L2, of a shadow VMCS L1 provides, if L0 offers
+ *   VMCS shadowing to L1.  These complete without an exit to L1.
+ *
+ * Averages are taken over @ref ITERS operations.  Requires VT-x in the guest
+ * (`nestedhvm = 1`), and a paged environment.
+ *
+ * @see tests/perf-nested-vmx/main.c
+ */
+#include <xtf.h>
+
+#include <arch/div.h>
+#include <arch/vmx.h>
+
+const char test_title[] = "Nested VT-x entry/exit and VMCS access cost";
+
+#define ITERS 1000
+
+static uint8_t vmxon_region[PAGE_SIZE] __page_aligned_bss;
+static uint8_t vmcs[PAGE_SIZE] __page_aligned_bss;
+static uint8_t shadow_vmcs[PAGE_SIZE] __page_aligned_bss;
+static uint8_t vmread_bitmap[PAGE_SIZE] __page_aligned_bss;
+static uint8_t vmwrite_bitmap[PAGE_SIZE] __page_aligned_bss;
+static uint8_t guest_stack[PAGE_SIZE] __page_aligned_bss;
+
+/* Cycles for ITERS shadow VMCS accesses, measured by shadow_guest(). */
+static uint64_t shadow_read_cycles, shadow_write_cycles;
+
+static void __noreturn vmcall_guest(void)
+{
+    for ( ;; )
+        asm volatile ("vmcall");
+}
+
+static void __noreturn cpuid_guest(void)
+{
+    for ( ;; )
+        asm volatile ("cpuid" ::: "eax", "ebx", "ecx", "edx");
+}
+
+static void __noreturn shadow_guest(void)
+{
+    uint64_t start;
+
+    start = rdtsc_ordered();
+    for ( unsigned int i = 0; i < ITERS; ++i )
+        vmread(VMCS_GUEST_RIP);
+    shadow_read_cycles = rdtsc_ordered() - start;
+
+    start = rdtsc_ordered();
+    for ( unsigned int i = 0; i < ITERS; ++i )
+        vmwrite(VMCS_GUEST_RIP, i);
+    shadow_write_cycles = rdtsc_ordered() - start;
+
+    for ( ;; )
+        asm volatile ("vmcall");
+}
+
+static void *guest_sp(void)
+{
+    return &guest_stack[PAGE_SIZE - sizeof(unsigned long)];
+}
+
+static uint32_t per_iter(uint64_t cycles)
+{
+    divmod64(&cycles, ITERS);
+
+    return cycles;
+}
+
+/* Enter the current VMCS, expecting an exit with @p reason. */
+static bool enter_expect(uint32_t reason, const char *what)
+{
+    uint32_t actual;
+
+    if ( !vmx_enter() )
+    {
+        xtf_error("Error: %s: VM entry failed: %s\n", what,
+                  vmx_insn_err_strerror(vmread(VMCS_VM_INSN_ERR)));
+        return false;
+    }
+
+    actual = vmx_exit_reason();
+    if ( actual != reason )
+    {
+        xtf_error("Error: %s: expected exit reason %u, got %#x\n",
+                  what, reason, actual);
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Time ITERS round trips into a guest at @p entry, which exits with
+ * @p reason without advancing.  With @p launch, each entry is a `vmlaunch`
+ * of a freshly cleared VMCS, otherwise a `vmresume`.
+ */
+static void time_round_trip(void (*entry)(void), uint32_t reason,
+                            bool launch, const char *what)
+{
+    uint64_t start, cycles;
+    int rc = vmx_init_vmcs(vmcs, entry, guest_sp(), 0, 0);
+
+    if ( rc )
+        return xtf_error("Error: %s: failed to build VMCS: %d\n", what, rc);
+
+    /* The first entry is a vmlaunch, and warms up. */
+    if ( !enter_expect(reason, what) )
+        return;
+
+    if ( launch )
+    {
+        if ( !vmx_relaunch(vmcs) )
+            return xtf_error("Error: %s: unable to relaunch VMCS\n", what);
+
+        /* Check a relaunch works, and warm up its path. */
+        if ( !enter_expect(reason, what) )
+            return;
+
+        start = rdtsc_ordered();
+        for ( unsigned int i = 0; i < ITERS; ++i )
+        {
+            vmx_relaunch(vmcs);
+            vmx_enter();
+        }
+        cycles = rdtsc_ordered() - start;
+    }
+    else
+    {
+        start = rdtsc_ordered();
+        for ( unsigned int i = 0; i < ITERS; ++i )
+            vmx_enter();
+        cycles = rdtsc_ordered() - start;
+    }
+
+    if ( !enter_expect(reason, what) )
+        return;
+
+    printk("  %-32s %9u\n", what, per_iter(cycles));
+}
+
+static void time_l1_access(void)
+{
+    uint64_t start, cycles;
+    unsigned long rip = vmread(VMCS_GUEST_RIP);
+
+    start = rdtsc_ordered();
+    for ( unsigned int i = 0; i < ITERS; ++i )
+        vmread(VMCS_GUEST_RIP);
+    cycles = rdtsc_ordered() - start;
+    printk("  %-32s %9u\n", "L1 vmread GUEST_RIP", per_iter(cycles));
+
+    start = rdtsc_ordered();
+    for ( unsigned int i = 0; i < ITERS; ++i )
+        vmread(VMCS_EXIT_REASON);
+    cycles = rdtsc_ordered() - start;
+    printk("  %-32s %9u\n", "L1 vmread EXIT_REASON", per_iter(cycles));
+
+    start = rdtsc_ordered();
+    for ( unsigned int i = 0; i < ITERS; ++i )
+        vmwrite(VMCS_GUEST_RIP, rip);
+    cycles = rdtsc_ordered() - start;
+    printk("  %-32s %9u\n", "L1 vmwrite GUEST_RIP", per_iter(cycles));
+}
+
+static void time_shadow_access(void)
+{
+    msr_vmx_basic_t basic = { rdmsr(MSR_VMX_BASIC) };
+    uint64_t ctls2;
+    int rc;
+
+    if ( rdmsr_safe(MSR_VMX_PROCBASED_CTLS2, &ctls2) ||
+         !((ctls2 >> 32) & VMX_PROC2_VMCS_SHADOWING) )
+        return printk("  VMCS shadowing not available\n");
+
+    rc = vmx_init_vmcs(vmcs, shadow_guest, guest_sp(), 0,
+                       VMX_PROC2_VMCS_SHADOWING);
+    if ( rc )
+        return xtf_error("Error: failed to build shadowing VMCS: %d\n", rc);
+
+    /* A shadow VMCS carries the shadow indicator in its revision id. */
+    *(uint32_t *)shadow_vmcs = basic.vmcs_rev_id | (1u << 31);
+
+    /* Clear bitmaps let L2 access every field without exiting. */
+    if ( !vmclear(_u(shadow_vmcs)) ||
+         !vmptrld(_u(vmcs)) ||
+         !vmwrite64(VMCS_LINK_PTR, _u(shadow_vmcs)) ||
+         !vmwrite64(VMCS_VMREAD_BITMAP, _u(vmread_bitmap)) ||
+         !vmwrite64(VMCS_VMWRITE_BITMAP, _u(vmwrite_bitmap)) )
+        return xtf_error("Error: failed to set up shadow VMCS\n");
+
+    if ( !enter_expect(VMX_EXIT_VMCALL, "Shadow VMCS access") )
+        return;
+
+    printk("  %-32s %9u\n", "L2 vmread (shadowed)",
+           per_iter(shadow_read_cycles));
+    printk("  %-32s %9u\n", "L2 vmwrite (shadowed)",
+           per_iter(shadow_write_cycles));
+}
+
+void test_main(void)
+{
+    int rc;
+
+    if ( !cpu_has_vmx )
+        return xtf_skip("Skip: VT-x not available\n");
+
+    rc = vmx_enable(vmxon_region);
+    if ( rc )
+        return xtf_error("Error: vmx_enable() failed: %d\n", rc);
+
+    printk("Cycles per operation:\n");
+
+    time_round_trip(vmcall_guest, VMX_EXIT_VMCALL, false,
+                    "vmresume/vmcall/exit");
+    time_round_trip(cpuid_guest, VMX_EXIT_CPUID, false,
+                    "vmresume/cpuid/exit");
+    time_round_trip(vmcall_guest, VMX_EXIT_VMCALL, true,
+                    "vmclear/vmptrld/vmlaunch/vmcall");
+
+    if ( !xtf_status_reported() )
+        time_l1_access();
+
+    if ( !xtf_status_reported() )
+        time_shadow_access();
+
+    vmx_disable();
+
+    xtf_success(NULL);
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,444 @@
+/**
+ * @file tests/perf-preempt/main.c
+ * @ref test-perf-preempt
+ *
+ * @page test-perf-preempt Hypercall preemption latency
+ *
+ * Long-running hypercalls are expected to check for pending work
+ * periodically, and if there is any, to return to the guest with a
+ * continuation, so the vCPU can take interrupts before the hypercall is
+ * restarted.  Measure the longest stretch for which a vCPU can't take
+ * interrupts, while issuing increasingly large batches of:
+ *
+ * - `decrease_reservation` and `populate_physmap` (HVM only), on 4k extents
+ *   of a region beyond the test's image.
+ * - `mmu_update` (PV only), remapping a window of the test's bss between its
+ *   original frames and an alias frame.
+ * - `GNTTABOP_copy`, copying a full page from a self-granted frame.
+ *
+ * A periodic Xen timer, with a @ref PERIOD_NS period, runs throughout.  Its
+ * handler records the largest gap between consecutive ticks, and each
+ * hypercall is issued just after a tick.  When a hypercall is preempted, the
+ * pending tick is delivered before the hypercall is restarted, so a gap
+ * longer than the period is a window in which the vCPU wasn't interruptible.
+ * Each batch is issued @ref REPS times, and the worst case is reported.
+ *
+ * Reported are the hypercall's duration, the number of ticks taken while it
+ * was in progress, the largest gap between ticks, and the excess of that gap
+ * over the period (the non-preemptible window).  A baseline, spinning in the
+ * guest, shows the timer's own jitter.  Windows longer than
+ * @ref WINDOW_WARN_NS are reported with a warning.
+ *
+ * @see tests/perf-preempt/main.c
+ */
+#include <xtf.h>
+
+#include <arch/div.h>
+
+#if defined(CONFIG_PV)
+#include <arch/mmu-batch.h>
+#endif
+
+const char test_title[] = "Hypercall preemption latency";
+
+#define PERIOD_NS      MICROSECONDS(100)
+#define BASELINE_NS    MILLISECONDS(10)
+#define WINDOW_WARN_NS MILLISECONDS(1)
+#define REPS           4
+
+#define MAX_MEMOP      16384
+#define MAX_MMU        16384
+#define MAX_COPY       4096
+
+#define NR_PTES        512
+
+static struct timer ticker;
+static volatile uint64_t last_tick, max_gap;
+static volatile unsigned int ticks;
+
+static domid_t domid;
+static grant_ref_t src_ref;
+static uint8_t src[PAGE_SIZE] __page_aligned_bss;
+static uint8_t dst[PAGE_SIZE] __page_aligned_bss;
+static struct gnttab_copy copies[MAX_COPY];
+
+#if defined(CONFIG_HVM)
+/* Beyond the end of the l1_identmap[] which the test must fit within. */
+#define MEMOP_REGION MB(16)
+
+static unsigned long gfns[MAX_MEMOP];
+#endif
+
+#if defined(CONFIG_PV)
+static uint8_t window[NR_PTES * PAGE_SIZE] __page_aligned_bss;
+static uint8_t alias[PAGE_SIZE] __page_aligned_bss;
+
+static uint64_t l1e[NR_PTES];
+static intpte_t orig_pte[NR_PTES], alias_pte;
+static mmu_update_t mmu_reqs[MAX_MMU];
+#endif
+
+/*
+ * A hypercall type.  issue() makes a single hypercall operating on @p nr
+ * items.  prepare() and cleanup(), if present, are called untimed, before
+ * and after each issue().
+ */
+struct call {
+    const char *name;
+    const unsigned int *sizes;
+    unsigned int nr_sizes;
+    int (*prepare)(unsigned int nr);
+    int (*issue)(unsigned int nr);
+    int (*cleanup)(unsigned int nr);
+};
+
+struct result {
+    uint64_t duration;          /* Longest hypercall, in ns.          */
+    uint64_t gap;               /* Longest gap between ticks, in ns.  */
+    unsigned int ticks;         /* Ticks taken during the hypercalls. */
+};
+
+static void tick(struct timer *t, void *data)
+{
+    uint64_t now = xen_system_time();
+
+    if ( now - last_tick > max_gap )
+        max_gap = now - last_tick;
+
+    last_tick = now;
+    ticks++;
+}
+
+#if defined(CONFIG_HVM)
+static long memop(unsigned int op, unsigned int nr)
+{
+    struct xen_memory_reservation res = {
+        .extent_start = gfns,
+        .nr_extents = nr,
+        .extent_order = 0,
+        .domid = DOMID_SELF,
+    };
+    long rc = hypercall_memory_op(op, &res);
+
+    return rc == (long)nr ? 0 : rc < 0 ? rc : -ENOMEM;
+}
+
+static int release(unsigned int nr)
+{
+    return memop(XENMEM_decrease_reservation, nr);
+}
+
+static int populate(unsigned int nr)
+{
+    return memop(XENMEM_populate_physmap, nr);
+}
+
+static const unsigned int memop_sizes[] = { 256, 1024, 4096, MAX_MEMOP };
+#endif /* CONFIG_HVM */
+
+#if defined(CONFIG_PV)
+/*
+ * Remap the window @p nr times over, PTE by PTE, alternating between the
+ * alias and the original frames on each pass.  An even number of passes
+ * leaves the window as it was.
+ */
+static int mmu(unsigned int nr)
+{
+    for ( unsigned int i = 0; i < nr; ++i )
+    {
+        unsigned int pte = i % NR_PTES;
+        bool aliased = !((i / NR_PTES) & 1);
+
+        mmu_reqs[i].ptr = l1e[pte] | MMU_NORMAL_PT_UPDATE;
+        mmu_reqs[i].val = aliased ? alias_pte : orig_pte[pte];
+    }
+
+    return hypercall_mmu_update(mmu_reqs, nr, NULL, DOMID_SELF);
+}
+
+static int mmu_flush(unsigned int nr)
+{
+    mmuext_op_t op = { .cmd = MMUEXT_TLB_FLUSH_LOCAL };
+
+    return hypercall_mmuext_op(&op, 1, NULL, DOMID_SELF);
+}
+
+static const unsigned int mmu_sizes[] = { 1024, 4096, MAX_MMU };
+#endif /* CONFIG_PV */
+
+static int copy(unsigned int nr)
+{
+    int rc = hypercall_grant_table_op(GNTTABOP_copy, copies, nr);
+
+    for ( unsigned int i = 0; !rc && i < nr; ++i )
+        if ( copies[i].status != GNTST_okay )
+            rc = -EIO;
+
+    return rc;
+}
+
+static const unsigned int copy_sizes[] = { 64, 256, 1024, MAX_COPY };
+
+static const struct call calls[] = {
+#if defined(CONFIG_HVM)
+    {
+        .name = "decrease_reservation",
+        .sizes = memop_sizes, .nr_sizes = ARRAY_SIZE(memop_sizes),
+        .issue = release, .cleanup = populate,
+    },
+    {
+        .name = "populate_physmap",
+        .sizes = memop_sizes, .nr_sizes = ARRAY_SIZE(memop_sizes),
+        .prepare = release, .issue = populate,
+    },
+#endif
+#if defined(CONFIG_PV)
+    {
+        .name = "mmu_update",
+        .sizes = mmu_sizes, .nr_sizes = ARRAY_SIZE(mmu_sizes),
+        .issue = mmu, .cleanup = mmu_flush,
+    },
+#endif
+    {
+        .name = "GNTTABOP_copy",
+        .sizes = copy_sizes, .nr_sizes = ARRAY_SIZE(copy_sizes),
+        .issue = copy,
+    },
+};
+
+/* Wait for a tick, and reset the gap tracking.  Upcalls are left enabled. */
+static void sync_tick(void)
+{
+    unsigned int t;
+
+    evtchn_disable_upcalls();
+    t = ticks;
+    evtchn_enable_upcalls();
+
+    while ( ACCESS_ONCE(ticks) == t )
+        ;
+
+    /* The next tick is a period away. */
+    max_gap = 0;
+}
+
+/* Account one measured interval, from @p start to @p end, into @p r. */
+static void account(struct result *r, uint64_t start, uint64_t end,
+                    unsigned int t)
+{
+    uint64_t gap;
+
+    evtchn_disable_upcalls();
+
+    gap = max(max_gap, end - last_tick);
+
+    r->duration = max(r->duration, end - start);
+    r->gap = max(r->gap, gap);
+    r->ticks += ticks - t;
+}
+
+static int measure(const struct call *c, unsigned int nr, struct result *r)
+{
+    for ( unsigned int rep = 0; rep < REPS; ++rep )
+    {
+        uint64_t start, end;
+        unsigned int t;
+        int rc;
+
+        if ( c->prepare && (rc = c->prepare(nr)) )
+            return rc;
+
+        sync_tick();
+
+        t = ticks;
+        start = xen_system_time();
+        rc = c->issue(nr);
+        end = xen_system_time();
+
+        account(r, start, end, t);
+
+        if ( rc )
+            return rc;
+
+        if ( c->cleanup && (rc = c->cleanup(nr)) )
+            return rc;
+    }
+
+    return 0;
+}
+
+static uint32_t us(uint64_t ns)
+{
+    ns += 500;
+    divmod64(&ns, 1000);
+
+    return ns;
+}
+
+static uint64_t excess(const struct result *r)
+{
+    return r->gap > PERIOD_NS ? r->gap - PERIOD_NS : 0;
+}
+
+static void print_result(const char *name, unsigned int nr,
+                         const struct result *r)
+{
+    printk("  %-20s %6u %9u %6u %8u %8u\n", name, nr, us(r->duration),
+           r->ticks, us(r->gap), us(excess(r)));
+}
+
+static void baseline(void)
+{
+    struct result r = {};
+    uint64_t start, end;
+    unsigned int t;
+
+    sync_tick();
+
+    t = ticks;
+    start = xen_system_time();
+    while ( (end = xen_system_time()) - start < BASELINE_NS )
+        ;
+
+    account(&r, start, end, t);
+    print_result("(spin)", 0, &r);
+}
+
+static bool run(const struct call *c)
+{
+    struct result worst = {};
+    unsigned int worst_nr = 0;
+
+    for ( unsigned int s = 0; s < c->nr_sizes; ++s )
+    {
+        unsigned int nr = c->sizes[s];
+        struct result r = {};
+        int rc = measure(c, nr, &r);
+
+        if ( rc )
+        {
+            xtf_error("Error: %s batch %u failed: %d\n", c->name, nr, rc);
+            return false;
+        }
+
+        print_result(c->name, nr, &r);
+
+        if ( !worst_nr || r.gap > worst.gap )
+        {
+            worst = r;
+            worst_nr = nr;
+        }
+    }
+
+    if ( excess(&worst) > WINDOW_WARN_NS )
+        xtf_warning("Warning: %s batch %u not preemptible for %u us\n",
+                    c->name, worst_nr, us(excess(&worst)));
+
+    return true;
+}
+
+static bool setup(void)
+{
+    int rc = xtf_get_domid();
+
+    if ( rc < 0 )
+    {
+        xtf_error("Error getting domid\n");
+        return false;
+    }
+
+    domid = rc;
+
+    rc = xtf_init_grant_table(1) ?:
+        gnttab_grant_access(domid, virt_to_gfn(src), true, &src_ref);
+    if ( rc )
+    {
+        xtf_error("Error: Unable to grant copy source: %d\n", rc);
+        return false;
+    }
+
+    for ( unsigned int i = 0; i < MAX_COPY; ++i )
+        copies[i] = (struct gnttab_copy){
+            .source = {
+                .u.ref = src_ref,
+                .domid = domid,
+            },
+            .dest = {
+                .u.gmfn = virt_to_gfn(dst),
+                .domid = domid,
+            },
+            .len = PAGE_SIZE,
+            .flags = GNTCOPY_source_gref,
+        };
+
+#if defined(CONFIG_HVM)
+    for ( unsigned int i = 0; i < MAX_MEMOP; ++i )
+        gfns[i] = (MEMOP_REGION >> PAGE_SHIFT) + i;
+#endif
+
+#if defined(CONFIG_PV)
+    for ( unsigned int i = 0; i < NR_PTES; ++i )
+    {
+        l1e[i] = pv_l1e_maddr(_u(&window[i * PAGE_SIZE]));
+        if ( !l1e[i] )
+        {
+            xtf_error("Error: window[%u] not mapped with 4k pages\n", i);
+            return false;
+        }
+
+        orig_pte[i] = *(intpte_t *)maddr_to_virt(l1e[i]);
+    }
+
+    alias_pte = pte_from_virt(alias, PF_SYM(AD, RW, P));
+#endif
+
+    rc = timer_init();
+    if ( rc )
+    {
+        xtf_error("Error: Unable to initialise timers: %d\n", rc);
+        return false;
+    }
+
+    timer_arm_periodic_ns(&ticker, xen_system_time() + PERIOD_NS, PERIOD_NS,
+                          tick, NULL);
+
+    return true;
+}
+
+void test_main(void)
+{
+    if ( !setup() )
+        return;
+
+    printk("Timer period %u us.  Worst case of %u, times in us:\n",
+           us(PERIOD_NS), REPS);
+    printk("  %-20s %6s %9s %6s %8s %8s\n", "Hypercall", "Batch",
+           "Duration", "Ticks", "Max gap", "Window");
+
+    baseline();
+
+    for ( unsigned int i = 0; i < ARRAY_SIZE(calls); ++i )
+        if ( !run(&calls[i]) )
+            break;
+
+    timer_cancel(&ticker);
+    evtchn_disable_upcalls();
+
+    if ( gnttab_end_access(src_ref) )
+        xtf_error("Error: Unable to revoke copy source\n");
+
+    if ( xtf_status_reported() )
+        return;
+
+    xtf_success(NULL);
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
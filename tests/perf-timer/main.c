@@ -0,0 +1,500 @@
+/**
+ * @file tests/perf-timer/main.c
+ * @ref test-perf-timer
+ *
+ * @page test-perf-timer Timer interrupt latency and jitter
+ *
+ * Program each available timer source repeatedly, and histogram the delta
+ * between the programmed expiry and the observed interrupt.
+ *
+ * Sources:
+ * - `xen`: Xen's single-shot timer, via #timer_arm_ns().
+ * - `xen periodic`: #timer_arm_periodic_ns(), reloading the single-shot
+ *   timer from the `VIRQ_TIMER` handler.
+ * - `lapic`: LAPIC timer, one-shot mode.
+ * - `lapic periodic`: LAPIC timer, periodic mode.
+ * - `tsc-deadline`: LAPIC timer, TSC-deadline mode.
+ * - `hpet`: HPET comparator, one-shot, routed via the IO-APIC.
+ *
+ * The LAPIC and HPET sources are HVM only, and are measured in both xAPIC
+ * and x2APIC modes.  PV guests only have the Xen sources.
+ *
+ * One-shot sources are armed @ref SAMPLES times, with delays between 100us
+ * and 275us, and the delta is from the intended expiry.  Periodic sources
+ * run for @ref SAMPLES periods of 500us, and the delta is each interval's
+ * deviation from the period.  Negative deltas (early interrupts) are counted
+ * separately.
+ *
+ * The vCPU is halted while waiting, so the figures include wakeup from idle.
+ * TSC and LAPIC timer rates are calibrated against Xen system time.
+ *
+ * @see tests/perf-timer/main.c
+ */
+#include <xtf.h>
+
+#include <arch/div.h>
+
+const char test_title[] = "Timer interrupt latency and jitter";
+
+/** Number of samples per source. */
+#define SAMPLES   256
+#define PERIOD_NS MICROSECONDS(500)
+#define CAL_NS    MILLISECONDS(10)
+#define TIMEOUT   MILLISECONDS(50)
+
+/* TSC cycles in CAL_NS. */
+static uint32_t cal_tsc;
+
+static struct timer xen_timer;
+
+static volatile unsigned int fired;
+static uint64_t fire[SAMPLES + 1], arm_tsc;
+
+/* Upper bounds of the histogram buckets, in ns. */
+static const uint32_t buckets[] = {
+    1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000,
+};
+
+struct result {
+    int64_t min, max, sum;
+    unsigned int nr, early;
+    unsigned int hist[ARRAY_SIZE(buckets) + 1];
+};
+
+/*
+ * A timer source.  arm() programs a single expiry @p ns after arm_tsc, or
+ * for periodic sources, starts them with period @p ns.
+ */
+struct source {
+    const char *name;
+    bool periodic;
+    void (*arm)(uint64_t ns);
+    void (*stop)(void);
+};
+
+static void record_fire(void)
+{
+    unsigned int i = fired;
+
+    if ( i < ARRAY_SIZE(fire) )
+        fire[i] = rdtsc();
+
+    fired = i + 1;
+}
+
+static uint64_t scale(uint64_t val, uint32_t mul, uint32_t div)
+{
+    val *= mul;
+    divmod64(&val, div);
+
+    return val;
+}
+
+static uint64_t tsc_to_ns(uint64_t tsc)
+{
+    return scale(tsc, CAL_NS, cal_tsc);
+}
+
+static void xen_hit(struct timer *t, void *data)
+{
+    record_fire();
+}
+
+static void xen_arm(uint64_t ns)
+{
+    timer_arm_ns(&xen_timer, xen_system_time() + ns, xen_hit, NULL);
+}
+
+static void xen_periodic_arm(uint64_t ns)
+{
+    timer_arm_periodic_ns(&xen_timer, xen_system_time() + ns, ns,
+                          xen_hit, NULL);
+}
+
+static void xen_stop(void)
+{
+    timer_cancel(&xen_timer);
+}
+
+static const struct source xen_sources[] = {
+    { "xen",          false, xen_arm,          xen_stop },
+    { "xen periodic", true,  xen_periodic_arm, xen_stop },
+};
+
+static void record(struct result *r, int64_t delta)
+{
+    unsigned int b;
+
+    if ( !r->nr || delta < r->min )
+        r->min = delta;
+    if ( !r->nr || delta > r->max )
+        r->max = delta;
+    r->sum += delta;
+    r->nr++;
+
+    if ( delta < 0 )
+    {
+        r->early++;
+        return;
+    }
+
+    for ( b = 0; b < ARRAY_SIZE(buckets); ++b )
+        if ( delta < buckets[b] )
+            break;
+
+    r->hist[b]++;
+}
+
+/*
+ * Arm a source, with a Xen timer as a backstop, and wait until @p nr
+ * interrupts have been seen.  Upcalls are disabled on return.
+ */
+static bool sample(const struct source *s, uint64_t ns, unsigned int nr,
+                   uint64_t timeout)
+{
+    static struct timer backstop;
+
+    timer_arm_ns(&backstop, xen_system_time() + timeout, NULL, NULL);
+
+    fired = 0;
+    arm_tsc = rdtsc_ordered();
+    s->arm(ns);
+
+    for ( ;; )
+    {
+        evtchn_disable_upcalls();
+
+        if ( fired >= nr || !timer_armed(&backstop) )
+            break;
+
+        evtchn_block();
+    }
+
+    s->stop();
+    timer_cancel(&backstop);
+
+    return fired >= nr;
+}
+
+static bool run_oneshot(const struct source *s, struct result *r)
+{
+    for ( unsigned int i = 0; i < SAMPLES; ++i )
+    {
+        uint64_t ns = MICROSECONDS(100 + (i % 8) * 25);
+
+        if ( !sample(s, ns, 1, ns + TIMEOUT) )
+            return false;
+
+        record(r, tsc_to_ns(fire[0] - arm_tsc) - ns);
+    }
+
+    return true;
+}
+
+static bool run_periodic(const struct source *s, struct result *r)
+{
+    if ( !sample(s, PERIOD_NS, SAMPLES + 1,
+                 (SAMPLES + 1) * PERIOD_NS + TIMEOUT) )
+        return false;
+
+    for ( unsigned int i = 1; i <= SAMPLES; ++i )
+        record(r, tsc_to_ns(fire[i] - fire[i - 1]) - PERIOD_NS);
+
+    return true;
+}
+
+static int64_t average(const struct result *r)
+{
+    uint64_t avg = r->sum < 0 ? -r->sum : r->sum;
+
+    divmod64(&avg, r->nr);
+
+    return r->sum < 0 ? -(int64_t)avg : (int64_t)avg;
+}
+
+static void print_header(void)
+{
+    printk("Delta from programmed expiry, in ns, and histogram by us:\n");
+    printk("%-6s %-14s %8s %8s %8s %5s", "Mode", "Source",
+           "Min", "Avg", "Max", "Early");
+
+    for ( unsigned int b = 0; b < ARRAY_SIZE(buckets); ++b )
+        printk(" %4u", buckets[b] / 1000);
+
+    printk(" %4s\n", "More");
+}
+
+static void print_result(const char *mode, const struct source *s,
+                         const struct result *r)
+{
+    printk("%-6s %-14s %8"PRId64" %8"PRId64" %8"PRId64" %5u", mode, s->name,
+           r->min, average(r), r->max, r->early);
+
+    for ( unsigned int b = 0; b < ARRAY_SIZE(r->hist); ++b )
+        printk(" %4u", r->hist[b]);
+
+    printk("\n");
+}
+
+static bool run_sources(const char *mode, const struct source *s,
+                        unsigned int nr)
+{
+    for ( ; nr; --nr, ++s )
+    {
+        struct result r = {};
+
+        if ( !(s->periodic ? run_periodic(s, &r) : run_oneshot(s, &r)) )
+        {
+            xtf_error("Error: %s %s: interrupt not seen after %u\n",
+                      mode, s->name, fired);
+            return false;
+        }
+
+        print_result(mode, s, &r);
+    }
+
+    return true;
+}
+
+/* Calibrate the TSC against Xen system time. */
+static void calibrate_tsc(void)
+{
+    uint64_t start_ns, start_tsc;
+
+    start_tsc = rdtsc_ordered();
+    start_ns = xen_system_time();
+
+    while ( xen_system_time() - start_ns < CAL_NS )
+        ;
+
+    cal_tsc = rdtsc_ordered() - start_tsc;
+}
+
+#if defined(CONFIG_HVM)
+/* LAPIC timer ticks in CAL_NS. */
+static uint32_t cal_apic;
+static unsigned int apic_id, hpet_nr, hpet_irq;
+
+void entry_timer_irq(void);
+void do_timer_irq(void);
+
+asm (".pushsection .text;"
+     "entry_timer_irq:"
+#ifdef __x86_64__
+     "push %rax; push %rcx; push %rdx; push %rsi; push %rdi;"
+     "push %r8; push %r9; push %r10; push %r11;"
+     "call do_timer_irq;"
+     "pop %r11; pop %r10; pop %r9; pop %r8;"
+     "pop %rdi; pop %rsi; pop %rdx; pop %rcx; pop %rax;"
+     "iretq;"
+#else
+     "push %eax; push %ecx; push %edx;"
+     "call do_timer_irq;"
+     "pop %edx; pop %ecx; pop %eax;"
+     "iret;"
+#endif
+     ".popsection;");
+
+void do_timer_irq(void)
+{
+    record_fire();
+    apic_write(APIC_EOI, 0);
+}
+
+static uint64_t ns_to_tsc(uint64_t ns)
+{
+    return scale(ns, cal_tsc, CAL_NS);
+}
+
+static uint64_t ns_to_apic(uint64_t ns)
+{
+    return scale(ns, cal_apic, CAL_NS);
+}
+
+static uint64_t ns_to_hpet(uint64_t ns)
+{
+    /* hpet_period is in femtoseconds. */
+    return scale(ns, 1000000, hpet_period);
+}
+
+static void lapic_arm(uint64_t ns)
+{
+    apic_write(APIC_LVTT, APIC_TIMER_ONESHOT | X86_VEC_AVAIL);
+    apic_write(APIC_TMICT, ns_to_apic(ns));
+}
+
+static void lapic_periodic_arm(uint64_t ns)
+{
+    apic_write(APIC_LVTT, APIC_TIMER_PERIODIC | X86_VEC_AVAIL);
+    apic_write(APIC_TMICT, ns_to_apic(ns));
+}
+
+static void tsc_deadline_arm(uint64_t ns)
+{
+    apic_write(APIC_LVTT, APIC_TIMER_TSC_DEADLINE | X86_VEC_AVAIL);
+    wrmsr(MSR_TSC_DEADLINE, arm_tsc + ns_to_tsc(ns));
+}
+
+static void lapic_stop(void)
+{
+    if ( apic_read(APIC_LVTT) & APIC_TIMER_TSC_DEADLINE )
+        wrmsr(MSR_TSC_DEADLINE, 0);
+
+    apic_write(APIC_TMICT, 0);
+    apic_write(APIC_LVTT, APIC_LVT_MASKED);
+}
+
+static void hpet_arm(uint64_t ns)
+{
+    hpet_init_timer(hpet_nr, hpet_irq, ns_to_hpet(ns), false, false, false);
+}
+
+static void hpet_stop(void)
+{
+    hpet_write32(HPET_Tn_CFG(hpet_nr), 0);
+}
+
+static const struct source lapic_sources[] = {
+    { "lapic",          false, lapic_arm,          lapic_stop },
+    { "lapic periodic", true,  lapic_periodic_arm, lapic_stop },
+    { "tsc-deadline",   false, tsc_deadline_arm,   lapic_stop },
+};
+
+static const struct source hpet_source = {
+    "hpet", false, hpet_arm, hpet_stop,
+};
+
+/* Calibrate the LAPIC timer against Xen system time. */
+static void calibrate_apic(void)
+{
+    uint64_t start_ns;
+
+    apic_write(APIC_LVTT, APIC_LVT_MASKED);
+    apic_write(APIC_TDCR, APIC_TDR_DIV_1);
+    apic_write(APIC_TMICT, ~0u);
+
+    start_ns = xen_system_time();
+
+    while ( xen_system_time() - start_ns < CAL_NS )
+        ;
+
+    cal_apic = ~0u - apic_read(APIC_TMCCT);
+    apic_write(APIC_TMICT, 0);
+}
+
+/*
+ * Find an HPET timer which can be routed via the IO-APIC, preferring
+ * non-ISA IRQs.
+ */
+static bool setup_hpet(void)
+{
+    if ( hpet_init() || !hpet_nr_timers || ioapic_init() )
+        return false;
+
+    for ( unsigned int n = 0; n < hpet_nr_timers; ++n )
+    {
+        uint32_t cap = hpet_read32(HPET_Tn_ROUTE_CAP(n));
+
+        if ( !cap )
+            continue;
+
+        hpet_nr = n;
+        hpet_irq = __builtin_ctz((cap & 0xffff0000) ?: cap);
+
+        return true;
+    }
+
+    return false;
+}
+
+static bool run_apic_modes(void)
+{
+    static const struct {
+        const char *name;
+        enum apic_mode mode;
+    } modes[] = {
+        { "xapic",  APIC_MODE_XAPIC },
+        { "x2apic", APIC_MODE_X2APIC },
+    };
+    const struct xtf_idte idte = {
+        .addr = _u(entry_timer_irq),
+        .cs = __KERN_CS,
+    };
+    bool has_hpet = setup_hpet();
+
+    xtf_set_idte(X86_VEC_AVAIL, &idte);
+
+    for ( unsigned int m = 0; m < ARRAY_SIZE(modes); ++m )
+    {
+        const char *name = modes[m].name;
+        unsigned int nr = ARRAY_SIZE(lapic_sources);
+
+        if ( apic_init(modes[m].mode) )
+        {
+            printk("%-6s unavailable\n", name);
+            continue;
+        }
+
+        apic_id = apic_read(APIC_ID);
+        if ( modes[m].mode == APIC_MODE_XAPIC )
+            apic_id >>= 24;
+
+        calibrate_apic();
+
+        /* TSC-deadline is last in the list. */
+        if ( !cpu_has_tsc_deadline )
+            nr--;
+
+        if ( !run_sources(name, lapic_sources, nr) )
+            return false;
+
+        if ( has_hpet )
+        {
+            if ( ioapic_set_redir(hpet_irq, X86_VEC_AVAIL, apic_id, false) )
+            {
+                xtf_error("Error: Unable to route IRQ %u\n", hpet_irq);
+                return false;
+            }
+
+            if ( !run_sources(name, &hpet_source, 1) )
+                return false;
+
+            ioapic_set_mask(hpet_irq, true);
+        }
+    }
+
+    return true;
+}
+#endif /* CONFIG_HVM */
+
+void test_main(void)
+{
+    int rc = timer_init();
+
+    if ( rc )
+        return xtf_error("Error: timer_init() failed: %d\n", rc);
+
+    evtchn_disable_upcalls();
+    calibrate_tsc();
+    print_header();
+
+    if ( !run_sources("-", xen_sources, ARRAY_SIZE(xen_sources)) )
+        return;
+
+#if defined(CONFIG_HVM)
+    if ( !run_apic_modes() )
+        return;
+#endif
+
+    xtf_success(NULL);
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
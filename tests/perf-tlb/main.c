@@ -0,0 +1,366 @@
+/**
+ * @file tests/perf-tlb/main.c
+ * @ref test-perf-tlb
+ *
+ * @page test-perf-tlb TLB and pagewalk cost
+ *
+ * Measure the cost of TLB misses, `invlpg` and `%%cr3` reloads for each
+ * mapping size available in the environment.  The test is built with the
+ * `hap` and `shadow` variations, so a single `xtf-runner` invocation gathers
+ * numbers for both paging modes.
+ *
+ * A 1G window of linear address space (1G to 2G, above the guest's RAM) is
+ * remapped in turn with 4k, 2M/4M and (64bit only, if supported) 1G
+ * mappings.  Every mapping aliases a single superpage-sized buffer in RAM
+ * (at 32M, with the 4k pagetables at 16M), so each configuration touches the
+ * same physical cachelines, and only the TLB footprint varies with the
+ * mapping size.
+ *
+ * For each working set size, one cacheline in each 4k page is read using a
+ * chain of dependent loads (so pagewalk latency isn't hidden by out-of-order
+ * execution), and the average number of TSC cycles per access is reported.
+ * For 1G mappings, and the unpaged environment, the working set is folded
+ * into the buffer, as the entire window is covered by a single TLB entry (or
+ * no guest translation at all) regardless.
+ *
+ * Additionally, the cost of an `invlpg`, a `%%cr3` reload, and of an access
+ * with a cold TLB following the reload are reported.
+ *
+ * If vPMU is available (Xen booted with `vpmu=on`) and the CPU has a known
+ * dTLB miss event, the number of dTLB misses per 1000 accesses is reported
+ * alongside the cycles, to confirm the working sets miss as intended.
+ *
+ * @see tests/perf-tlb/main.c
+ */
+#include <xtf.h>
+
+#include <arch/div.h>
+#include <arch/pmu.h>
+
+const char test_title[] = "TLB and pagewalk cost";
+
+#define WIN_START   _u(GB(1))
+#define WIN_SIZE    _u(GB(1))
+#define WIN_PAGES   (WIN_SIZE >> PAGE_SHIFT)
+
+/* A superpage (2M or 4M), and the number of 4k pages it covers. */
+#define SP_SIZE     (1UL << L2_PT_SHIFT)
+#define SP_PAGES    (SP_SIZE >> PAGE_SHIFT)
+
+/* Approximate number of accesses to average over for each result. */
+#define NR_ACCESSES (1u << 20)
+
+/* Pages touched, and repetitions, for the flush measurements. */
+#define FLUSH_PAGES 512
+#define FLUSH_REPS  64
+
+/* Working set sizes, in 4k pages.  64k to 1G. */
+static const unsigned int ws_pages[] = {
+    16, 64, 256, 1024, 4096, 16384, 65536, 262144,
+};
+
+struct mode {
+    const char *name;
+    void (*map)(void);
+    unsigned long base;
+    unsigned int mask;
+
+    uint32_t access[ARRAY_SIZE(ws_pages)];
+    uint32_t dtlb[ARRAY_SIZE(ws_pages)];
+    uint32_t invlpg, cr3, cold;
+};
+
+static struct mode modes[3];
+static unsigned int nr_modes;
+static bool count_dtlb;
+
+/*
+ * Scratch RAM beyond the end of the image, for the aliased buffer and the 4k
+ * pagetables.  Both are too large to fit within l1_identmap[].
+ */
+static uint8_t *const backing = _p(MB(32));
+
+#if CONFIG_PAGING_LEVELS > 0
+
+#define WIN_L2_IDX  (WIN_START >> L2_PT_SHIFT)
+
+static intpte_t *const l1t = _p(MB(16));
+static intpte_t saved_l2e[WIN_SIZE >> L2_PT_SHIFT];
+
+static void map_4k(void)
+{
+    for ( unsigned int i = 0; i < ARRAY_SIZE(saved_l2e); ++i )
+        l2_identmap[WIN_L2_IDX + i] =
+            pte_from_virt(&l1t[i * L1_PT_ENTRIES], PF_SYM(AD, RW, P));
+
+    flush_tlb();
+}
+
+static void map_superpage(void)
+{
+    for ( unsigned int i = 0; i < ARRAY_SIZE(saved_l2e); ++i )
+        l2_identmap[WIN_L2_IDX + i] =
+            pte_from_virt(backing, PF_SYM(PSE, AD, RW, P));
+
+    flush_tlb();
+}
+
+#if CONFIG_PAGING_LEVELS == 4
+
+#define WIN_L3_IDX  (WIN_START >> L3_PT_SHIFT)
+
+static intpte_t saved_l3e;
+
+static void map_1g(void)
+{
+    pae_l3_identmap[WIN_L3_IDX] = pte_from_paddr(0, PF_SYM(PSE, AD, RW, P));
+
+    flush_tlb();
+}
+
+#endif /* CONFIG_PAGING_LEVELS == 4 */
+#endif /* CONFIG_PAGING_LEVELS > 0 */
+
+static void add_mode(const char *name, void (*map)(void),
+                     unsigned long base, unsigned int mask)
+{
+    struct mode *m = &modes[nr_modes++];
+
+    m->name = name;
+    m->map  = map;
+    m->base = base;
+    m->mask = mask;
+}
+
+static void setup_modes(void)
+{
+#if CONFIG_PAGING_LEVELS > 0
+    for ( unsigned int i = 0; i < WIN_PAGES; ++i )
+        l1t[i] = pte_from_virt(backing + ((i & (SP_PAGES - 1)) << PAGE_SHIFT),
+                               PF_SYM(AD, RW, P));
+
+    for ( unsigned int i = 0; i < ARRAY_SIZE(saved_l2e); ++i )
+        saved_l2e[i] = l2_identmap[WIN_L2_IDX + i];
+
+    add_mode("4K", map_4k, WIN_START, ~0u);
+    add_mode(CONFIG_PAGING_LEVELS == 2 ? "4M" : "2M",
+             map_superpage, WIN_START, ~0u);
+
+#if CONFIG_PAGING_LEVELS == 4
+    saved_l3e = pae_l3_identmap[WIN_L3_IDX];
+
+    if ( cpu_has_page1gb )
+        add_mode("1G", map_1g, WIN_START + _u(backing), SP_PAGES - 1);
+#endif
+
+#else /* CONFIG_PAGING_LEVELS > 0 */
+    add_mode("None", NULL, _u(backing), SP_PAGES - 1);
+#endif
+}
+
+static void restore_mappings(void)
+{
+#if CONFIG_PAGING_LEVELS > 0
+    for ( unsigned int i = 0; i < ARRAY_SIZE(saved_l2e); ++i )
+        l2_identmap[WIN_L2_IDX + i] = saved_l2e[i];
+
+#if CONFIG_PAGING_LEVELS == 4
+    pae_l3_identmap[WIN_L3_IDX] = saved_l3e;
+#endif
+
+    flush_tlb();
+#endif
+}
+
+static unsigned long page_addr(const struct mode *m, unsigned int i)
+{
+    return m->base + ((unsigned long)(i & m->mask) << PAGE_SHIFT);
+}
+
+/*
+ * Read one cacheline from each of @p nr pages.  The address of each load
+ * depends on the result of the previous one, so the accesses are strictly
+ * serialised.  Returns the number of TSC cycles taken.
+ */
+static uint64_t walk(const struct mode *m, unsigned int nr)
+{
+    unsigned long dep = 0;
+    uint64_t start = rdtsc_ordered();
+
+    for ( unsigned int i = 0; i < nr; ++i )
+    {
+        unsigned long va = page_addr(m, i) + ((i & 63) << 6) + dep;
+
+        asm volatile ("mov (%[va]), %[dep];"
+                      "and $0, %[dep];"
+                      : [dep] "=r" (dep)
+                      : [va] "r" (va)
+                      : "memory");
+    }
+
+    return rdtsc_ordered() - start;
+}
+
+/*
+ * Returns the average cycles per access, and the dTLB misses per 1000
+ * accesses in @p dtlb, if counting.
+ */
+static uint32_t measure_access(const struct mode *m, unsigned int nr,
+                               uint32_t *dtlb)
+{
+    unsigned int passes = max(1u, NR_ACCESSES / nr);
+    struct pmu_sample start, end;
+    uint64_t cycles = 0, misses;
+
+    /* Warm up the caches and TLB. */
+    walk(m, nr);
+
+    pmu_read(&start);
+
+    for ( unsigned int p = 0; p < passes; ++p )
+        cycles += walk(m, nr);
+
+    pmu_read(&end);
+
+    misses = pmu_delta(&start, &end, PMU_DTLB_MISSES) * 1000;
+    divmod64(&misses, passes * nr);
+    *dtlb = misses;
+
+    divmod64(&cycles, passes * nr);
+
+    return cycles;
+}
+
+static void measure_flushes(struct mode *m)
+{
+    unsigned long cr3 = read_cr3();
+    uint64_t inv = 0, reload = 0, cold = 0, start;
+
+    for ( unsigned int rep = 0; rep < FLUSH_REPS; ++rep )
+    {
+        walk(m, FLUSH_PAGES);
+
+        start = rdtsc_ordered();
+        for ( unsigned int i = 0; i < FLUSH_PAGES; ++i )
+            invlpg(_p(page_addr(m, i)));
+        inv += rdtsc_ordered() - start;
+
+        walk(m, FLUSH_PAGES);
+
+        start = rdtsc_ordered();
+        write_cr3(cr3);
+        reload += rdtsc_ordered() - start;
+
+        cold += walk(m, FLUSH_PAGES);
+    }
+
+    divmod64(&inv,    FLUSH_REPS * FLUSH_PAGES);
+    divmod64(&reload, FLUSH_REPS);
+    divmod64(&cold,   FLUSH_REPS * FLUSH_PAGES);
+
+    m->invlpg = inv;
+    m->cr3    = reload;
+    m->cold   = cold;
+}
+
+/* Print the size of working set @p i, as a row label. */
+static void print_ws(unsigned int i)
+{
+    unsigned int kb = ws_pages[i] * (PAGE_SIZE >> 10);
+
+    if ( kb >= 1024 )
+        printk("  %11uM", kb >> 10);
+    else
+        printk("  %11uK", kb);
+}
+
+static void print_results(void)
+{
+    unsigned int i, j;
+
+    printk("Cycles per access, by working set and mapping size:\n");
+    printk("  %-12s", "Working set");
+    for ( j = 0; j < nr_modes; ++j )
+        printk(" %8s", modes[j].name);
+    printk("\n");
+
+    for ( i = 0; i < ARRAY_SIZE(ws_pages); ++i )
+    {
+        print_ws(i);
+        for ( j = 0; j < nr_modes; ++j )
+            printk(" %8u", modes[j].access[i]);
+        printk("\n");
+    }
+
+    if ( count_dtlb )
+    {
+        printk("dTLB misses per 1000 accesses:\n");
+
+        for ( i = 0; i < ARRAY_SIZE(ws_pages); ++i )
+        {
+            print_ws(i);
+            for ( j = 0; j < nr_modes; ++j )
+                printk(" %8u", modes[j].dtlb[i]);
+            printk("\n");
+        }
+    }
+
+    printk("Flush costs (cycles):\n");
+
+    printk("  %-12s", "invlpg");
+    for ( j = 0; j < nr_modes; ++j )
+        printk(" %8u", modes[j].invlpg);
+    printk("\n");
+
+    printk("  %-12s", "cr3 reload");
+    for ( j = 0; j < nr_modes; ++j )
+        printk(" %8u", modes[j].cr3);
+    printk("\n");
+
+    printk("  %-12s", "cold access");
+    for ( j = 0; j < nr_modes; ++j )
+        printk(" %8u", modes[j].cold);
+    printk("\n");
+}
+
+void test_main(void)
+{
+    count_dtlb = (pmu_init() == 0 &&
+                  pmu_enable(PMU_EVENT(PMU_DTLB_MISSES)));
+    if ( !count_dtlb )
+        printk("dTLB miss counting not available\n");
+
+    setup_modes();
+
+    for ( unsigned int j = 0; j < nr_modes; ++j )
+    {
+        struct mode *m = &modes[j];
+
+        if ( m->map )
+            m->map();
+
+        for ( unsigned int i = 0; i < ARRAY_SIZE(ws_pages); ++i )
+            m->access[i] = measure_access(m, ws_pages[i], &m->dtlb[i]);
+
+        measure_flushes(m);
+    }
+
+    restore_mappings();
+
+    if ( count_dtlb )
+        pmu_disable();
+
+    print_results();
+
+    xtf_success(NULL);
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,380 @@
+/**
+ * @file tests/perf-xenstore/main.c
+ * @ref test-perf-xenstore
+ *
+ * @page test-perf-xenstore Xenstore throughput and latency
+ *
+ * Measure xenstored throughput and latency, for read, write, directory and
+ * transaction workloads, at varying concurrency and payload size.
+ *
+ * Concurrency is the number of requests kept in flight, pipelined on the
+ * xenbus ring and matched to replies by `req_id`.  Each workload issues
+ * @ref OPS operations, against keys under the domain's `data/perf` node:
+ *
+ * - `read`: Read a key holding a value of the payload size.
+ * - `write`: Write a value of the payload size.
+ * - `directory`: List `data/perf`, which has @ref MAX_CONC children.
+ * - `transaction`: Start a transaction, write a value of the payload size,
+ *   and commit.  Concurrent transactions write to distinct keys.
+ *   Conflicting commits (`EAGAIN`) are counted, not retried.
+ *
+ * Throughput is reported in operations per second, and latency (from
+ * submission to reply) in microseconds at the 50th, 90th and 99th
+ * percentiles, and the maximum.  The xenbus transport's event channel kicks
+ * and blocking polls are reported per request, as a measure of notification
+ * overhead.
+ *
+ * Payloads larger than the domain's xenstore quota permits are reported and
+ * skipped, as are transaction concurrencies above the domain's transaction
+ * quota (10 by default in C xenstored).  Nothing here is specific to a xenstored implementation, so the
+ * results are directly comparable between C xenstored and oxenstored.
+ *
+ * @see tests/perf-xenstore/main.c
+ */
+#include <xtf.h>
+
+#include <arch/div.h>
+
+const char test_title[] = "Xenstore throughput and latency";
+
+#define OPS      512
+#define MAX_CONC 64
+#define DIR      "data/perf"
+
+static const unsigned int concurrency[] = { 1, 4, 16, MAX_CONC };
+static const unsigned int sizes[] = { 16, 256, 1024, 2048, 4000 };
+
+enum workload {
+    WL_READ,
+    WL_WRITE,
+    WL_DIRECTORY,
+    WL_TRANSACTION,
+};
+
+static const char *const workload_names[] = {
+    [WL_READ]        = "read",
+    [WL_WRITE]       = "write",
+    [WL_DIRECTORY]   = "directory",
+    [WL_TRANSACTION] = "transaction",
+};
+
+static struct xenstore_req reqs[MAX_CONC];
+static char bufs[MAX_CONC][XENSTORE_PAYLOAD_MAX + 1];
+static uint64_t submitted[MAX_CONC];
+static uint32_t txs[MAX_CONC];
+
+static char value[XENSTORE_PAYLOAD_MAX];
+static uint32_t lat[OPS];
+static unsigned int conflicts;
+
+static const char *key(unsigned int i)
+{
+    static char path[32];
+
+    snprintf(path, sizeof(path), DIR "/%u", i);
+
+    return path;
+}
+
+static int submit(enum workload wl, unsigned int slot, unsigned int size)
+{
+    struct xenstore_req *req = &reqs[slot];
+
+    switch ( wl )
+    {
+    case WL_READ:
+        return xenstore_submit(req, XS_READ, 0, key(slot), NULL, 0);
+
+    case WL_WRITE:
+        return xenstore_submit(req, XS_WRITE, 0, key(slot), value, size);
+
+    case WL_DIRECTORY:
+        return xenstore_submit(req, XS_DIRECTORY, 0, DIR, NULL, 0);
+
+    default:
+        return -EINVAL;
+    }
+}
+
+/* Keep @p conc requests in flight, until OPS have completed. */
+static int run_pipelined(enum workload wl, unsigned int conc,
+                         unsigned int size)
+{
+    unsigned int sent, done = 0;
+    int rc = 0;
+
+    /* Only count requests which made it onto the ring. */
+    for ( sent = 0; sent < conc; ++sent )
+    {
+        submitted[sent] = xen_system_time();
+        rc = submit(wl, sent, size);
+        if ( rc )
+            break;
+    }
+
+    while ( !rc && done < OPS )
+    {
+        /* xenstored replies in order, so the oldest request is next. */
+        unsigned int slot = done % conc;
+        uint64_t now;
+
+        rc = xenstore_wait(&reqs[slot]);
+        now = xen_system_time();
+
+        lat[done++] = now - submitted[slot];
+
+        if ( !rc && sent < OPS )
+        {
+            submitted[slot] = now;
+            rc = submit(wl, slot, size);
+            if ( !rc )
+                sent++;
+        }
+    }
+
+    /* Collect outstanding replies on error, to leave the ring idle. */
+    for ( ; done < sent; ++done )
+        xenstore_wait(&reqs[done % conc]);
+
+    return rc;
+}
+
+/*
+ * Run transactions in rounds of @p conc, each phase (start, write, commit)
+ * pipelined across the round.  On error, every submitted request is waited
+ * for, and transactions not yet committed are abandoned.
+ */
+static int run_transactions(unsigned int conc, unsigned int size)
+{
+    unsigned int done = 0, nr, i;
+    int rc = 0, err;
+
+    while ( !rc && done < OPS )
+    {
+        for ( i = 0; i < conc; ++i )
+            txs[i] = 0;
+
+        for ( nr = 0; nr < conc; ++nr )
+        {
+            submitted[nr] = xen_system_time();
+            rc = xenstore_submit(&reqs[nr], XS_TRANSACTION_START, 0, "",
+                                 NULL, 0);
+            if ( rc )
+                break;
+        }
+
+        for ( i = 0; i < nr; ++i )
+        {
+            err = (xenstore_wait(&reqs[i]) ?:
+                   xenstore_parse_tx(bufs[i], &txs[i]));
+            rc = rc ?: err;
+        }
+
+        for ( nr = 0; !rc && nr < conc; ++nr )
+        {
+            rc = xenstore_submit(&reqs[nr], XS_WRITE, txs[nr], key(nr),
+                                 value, size);
+            if ( rc )
+                break;
+        }
+
+        for ( i = 0; i < nr; ++i )
+        {
+            err = xenstore_wait(&reqs[i]);
+            rc = rc ?: err;
+        }
+
+        for ( nr = 0; !rc && nr < conc; ++nr )
+        {
+            rc = xenstore_submit(&reqs[nr], XS_TRANSACTION_END, txs[nr], "T",
+                                 NULL, 0);
+            if ( rc )
+                break;
+        }
+
+        for ( i = 0; i < nr; ++i )
+        {
+            err = xenstore_wait(&reqs[i]);
+            txs[i] = 0;
+
+            if ( err == -EAGAIN )
+                conflicts++;
+            else
+                rc = rc ?: err;
+
+            if ( done < OPS )
+                lat[done++] = xen_system_time() - submitted[i];
+        }
+
+        /* Abandon transactions left open by an error. */
+        for ( i = 0; i < conc; ++i )
+            if ( txs[i] )
+                xenstore_transaction_end(txs[i], false);
+    }
+
+    return rc;
+}
+
+static int cmp_u32(const void *_l, const void *_r)
+{
+    uint32_t l = *(const uint32_t *)_l, r = *(const uint32_t *)_r;
+
+    return (l > r) - (l < r);
+}
+
+static void swap_u32(void *_l, void *_r)
+{
+    uint32_t *l = _l, *r = _r, tmp = *l;
+
+    *l = *r;
+    *r = tmp;
+}
+
+static uint32_t us(uint32_t ns)
+{
+    return (ns + 500) / 1000;
+}
+
+/* Print @p num / @p den to 2 decimal places. */
+static void print_ratio(unsigned long num, unsigned long den)
+{
+    unsigned long hundredths = den ? (num * 100 + den / 2) / den : 0;
+
+    printk(" %4lu.%02lu", hundredths / 100, hundredths % 100);
+}
+
+static void print_result(unsigned int conc, unsigned int size,
+                         uint64_t elapsed, const struct xenstore_stats *start)
+{
+    uint64_t ops = OPS * 1000000ull;
+    unsigned long reqs = xenstore_stats.requests - start->requests;
+
+    /* Elapsed time in us, so the divisor fits in 32 bits. */
+    divmod64(&elapsed, 1000);
+    divmod64(&ops, elapsed ?: 1);
+
+    heapsort(lat, OPS, sizeof(*lat), cmp_u32, swap_u32);
+
+    printk("  %5u %5u %9"PRIu64" %7u %7u %7u %7u", conc, size, ops,
+           us(lat[OPS / 2]), us(lat[OPS * 9 / 10]),
+           us(lat[OPS * 99 / 100]), us(lat[OPS - 1]));
+
+    print_ratio(xenstore_stats.kicks - start->kicks, reqs);
+    print_ratio(xenstore_stats.polls - start->polls, reqs);
+
+    if ( conflicts )
+        printk("  (%u conflicts)", conflicts);
+
+    printk("\n");
+}
+
+/* Populate DIR with MAX_CONC keys, each holding @p size bytes. */
+static int populate(unsigned int size)
+{
+    for ( unsigned int i = 0; i < MAX_CONC; ++i )
+    {
+        int rc = submit(WL_WRITE, i, size);
+
+        if ( rc )
+            return rc;
+    }
+
+    for ( unsigned int i = 0; i < MAX_CONC; ++i )
+    {
+        int rc = xenstore_wait(&reqs[i]);
+
+        if ( rc )
+        {
+            while ( ++i < MAX_CONC )
+                xenstore_wait(&reqs[i]);
+
+            return rc;
+        }
+    }
+
+    return 0;
+}
+
+static bool run_workload(enum workload wl)
+{
+    printk("Workload: %s\n", workload_names[wl]);
+    printk("  %5s %5s %9s %7s %7s %7s %7s %7s %7s\n", "Conc", "Size",
+           "Ops/s", "p50 us", "p90 us", "p99 us", "Max us", "Kicks", "Polls");
+
+    for ( unsigned int s = 0; s < ARRAY_SIZE(sizes); ++s )
+    {
+        unsigned int size = sizes[s];
+        int rc = populate(size);
+
+        if ( rc )
+        {
+            printk("  %5s %5u  Unable to write: %d\n", "-", size, rc);
+            continue;
+        }
+
+        /* Directory listings don't depend on the value size. */
+        if ( wl == WL_DIRECTORY && s )
+            break;
+
+        for ( unsigned int c = 0; c < ARRAY_SIZE(concurrency); ++c )
+        {
+            unsigned int conc = concurrency[c];
+            struct xenstore_stats stats = xenstore_stats;
+            uint64_t start = xen_system_time();
+
+            conflicts = 0;
+            rc = (wl == WL_TRANSACTION ? run_transactions(conc, size)
+                                       : run_pipelined(wl, conc, size));
+            if ( wl == WL_TRANSACTION && rc == -ENOSPC )
+            {
+                printk("  %5u %5u  Transaction quota exceeded\n", conc, size);
+                continue;
+            }
+
+            if ( rc )
+            {
+                xtf_error("Error: %s, concurrency %u, size %u: %d\n",
+                          workload_names[wl], conc, size, rc);
+                return false;
+            }
+
+            print_result(conc, wl == WL_DIRECTORY ? 0 : size,
+                         xen_system_time() - start, &stats);
+        }
+    }
+
+    return true;
+}
+
+void test_main(void)
+{
+    if ( xenstore_init() )
+        return xtf_skip("Skip: No xenstore\n");
+
+    for ( unsigned int i = 0; i < ARRAY_SIZE(reqs); ++i )
+        xenstore_req_init(&reqs[i], bufs[i], sizeof(bufs[i]));
+
+    for ( unsigned int i = 0; i < ARRAY_SIZE(value); ++i )
+        value[i] = 'a' + (i % 26);
+
+    for ( unsigned int wl = 0; wl < ARRAY_SIZE(workload_names); ++wl )
+        if ( !run_workload(wl) )
+            break;
+
+    xenstore_rm(0, DIR);
+
+    if ( xtf_status_reported() )
+        return;
+
+    xtf_success(NULL);
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,174 @@
+/**
+ * @file tests/perf-xsave/main.c
+ * @ref test-perf-xsave
+ *
+ * @page test-perf-xsave Vector state context switch cost
+ *
+ * Measure the cost Xen's FPU/XSAVE context switching adds to a vCPU switch,
+ * as a function of the vector state enabled and in use.
+ *
+ * A second vCPU is brought up, spinning on `SCHEDOP_yield`.  Both vCPUs are
+ * pinned to the same pCPU (`cpus = "0"`), so each `SCHEDOP_yield` by the
+ * first vCPU is a ping-pong: a switch to the second vCPU, its yield, and a
+ * switch back.  The first vCPU enables progressively more XSAVE components
+ * with xstate_enable(), fills every register of them (so they aren't in their
+ * init state, and XSAVEOPT/XSAVES can't skip them), and times
+ * @ref ITERS yields.
+ *
+ * The state is read back afterwards, and any corruption is a failure.  The
+ * percentage of yields during which the second vCPU ran is reported, as a
+ * sanity check that the switches really happened.  The register fill and
+ * readback are in `simd.c`, built with the SIMD build flags (`obj-simd`).
+ *
+ * @see tests/perf-xsave/main.c
+ */
+#include <xtf.h>
+
+#include <arch/div.h>
+#include <arch/xstate.h>
+
+#include "test.h"
+
+const char test_title[] = "Vector state context switch cost";
+
+#define ITERS 1000
+
+static uint8_t vcpu1_stack[PAGE_SIZE] __page_aligned_bss;
+static unsigned long vcpu1_yields;
+
+static uint8_t pattern[AVX512_STATE_SIZE] __aligned(64);
+static uint8_t readback[AVX512_STATE_SIZE] __aligned(64);
+
+static const struct config {
+    const char *name;
+    uint64_t xcr0;
+    void (*fill)(const void *buf);
+    void (*save)(void *buf);
+    size_t size;
+} configs[] = {
+    { "x87/SSE, init state", XSTATE_FP | XSTATE_SSE, NULL, NULL, 0 },
+    { "SSE", XSTATE_FP | XSTATE_SSE,
+      simd_fill_sse, simd_save_sse, SSE_STATE_SIZE },
+    { "AVX", XSTATE_FP | XSTATE_SSE | XSTATE_YMM,
+      simd_fill_avx, simd_save_avx, AVX_STATE_SIZE },
+    { "AVX-512", XSTATE_FP | XSTATE_SSE | XSTATE_YMM | XSTATE_AVX512,
+      simd_fill_avx512, simd_save_avx512, AVX512_STATE_SIZE },
+};
+
+static void __noreturn vcpu1_main(void)
+{
+    for ( ;; )
+    {
+        ACCESS_ONCE(vcpu1_yields)++;
+        hypercall_yield();
+    }
+}
+
+static int start_vcpu1(void)
+{
+    static struct xen_vcpu_hvm_context ctx = {
+        .mode = VCPU_HVM_MODE_64B,
+    };
+    int rc;
+
+    ctx.cpu_regs.x86_64 = (struct xen_vcpu_hvm_x86_64){
+        .rip    = _u(vcpu1_main),
+        .rsp    = _u(&vcpu1_stack[PAGE_SIZE - sizeof(unsigned long)]),
+        .rflags = X86_EFLAGS_MBS,
+        .cr0    = read_cr0(),
+        .cr3    = read_cr3(),
+        .cr4    = read_cr4(),
+        .efer   = rdmsr(MSR_EFER),
+    };
+
+    rc = hypercall_vcpu_op(VCPUOP_initialise, 1, &ctx);
+    if ( !rc )
+        rc = hypercall_vcpu_op(VCPUOP_up, 1, NULL);
+
+    return rc;
+}
+
+static void measure(const struct config *c)
+{
+    unsigned long yields;
+    uint64_t start, cycles;
+    int rc = xstate_enable(c->xcr0);
+
+    if ( rc )
+    {
+        printk("  %-20s %18s\n", c->name, "n/a");
+        return;
+    }
+
+    if ( c->fill )
+        c->fill(pattern);
+
+    /* Warm up. */
+    hypercall_yield();
+
+    yields = ACCESS_ONCE(vcpu1_yields);
+    start = rdtsc_ordered();
+    for ( unsigned int i = 0; i < ITERS; ++i )
+        hypercall_yield();
+    cycles = rdtsc_ordered() - start;
+    yields = ACCESS_ONCE(vcpu1_yields) - yields;
+
+    if ( c->save )
+    {
+        memset(readback, 0, sizeof(readback));
+        c->save(readback);
+
+        if ( memcmp(pattern, readback, c->size) )
+            xtf_failure("Fail: %s state corrupted across context switches\n",
+                        c->name);
+    }
+
+    divmod64(&cycles, ITERS);
+
+    printk("  %-20s %#8"PRIx64" %9u %8lu%%\n", c->name, read_xcr0(),
+           (uint32_t)cycles, yields * 100 / ITERS);
+}
+
+void test_main(void)
+{
+    int rc;
+
+    if ( !cpu_has_sse2 )
+        return xtf_skip("Skip: SSE2 not available\n");
+
+    /*
+     * Non-zero register contents.  Only the low 16 bits of %k1-7 are covered
+     * (see simd.c), so the rest of the mask register area stays zero.
+     */
+    for ( unsigned int i = 0; i < 32 * 64; ++i )
+        pattern[i] = i * 7 + 1;
+    for ( unsigned int k = 1; k < 8; ++k )
+    {
+        pattern[32 * 64 + k * 8]     = k;
+        pattern[32 * 64 + k * 8 + 1] = 0x5a;
+    }
+
+    rc = start_vcpu1();
+    if ( rc )
+        return xtf_error("Error: Unable to start vCPU1: %d\n", rc);
+
+    printk("Cycles per SCHEDOP_yield ping-pong, by vector state in use:\n");
+    printk("  %-20s %8s %9s %9s\n", "State", "XCR0", "Cycles", "Switched");
+
+    for ( unsigned int i = 0; i < ARRAY_SIZE(configs); ++i )
+        measure(&configs[i]);
+
+    hypercall_vcpu_op(VCPUOP_down, 1, NULL);
+
+    xtf_success(NULL);
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,91 @@
+/**
+ * @file tests/perf-xsave/simd.c
+ *
+ * Vector register fill and readback.  Listed in obj-simd, so compiled with
+ * SIMD_CFLAGS, and the AVX/AVX-512 functions carry target() attributes.
+ */
+#include "test.h"
+
+void simd_fill_sse(const void *buf)
+{
+    asm volatile (".irp n, 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15;"
+                  "movdqu \\n * 16(%[buf]), %%xmm\\n;"
+                  ".endr"
+                  :: [buf] "r" (buf), "m" (*(const char (*)[SSE_STATE_SIZE])buf)
+                  : "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6",
+                    "xmm7", "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13",
+                    "xmm14", "xmm15");
+}
+
+void simd_save_sse(void *buf)
+{
+    asm volatile (".irp n, 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15;"
+                  "movdqu %%xmm\\n, \\n * 16(%[buf]);"
+                  ".endr"
+                  : "=m" (*(char (*)[SSE_STATE_SIZE])buf)
+                  : [buf] "r" (buf));
+}
+
+/*
+ * The wide fills don't list the registers they load as clobbers.  Nothing
+ * live is held in them, and a clobber of a %ymm/%zmm register causes GCC to
+ * emit `vzeroupper` on return, discarding the state just loaded.
+ */
+void __attribute__((target("avx"))) simd_fill_avx(const void *buf)
+{
+    asm volatile (".irp n, 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15;"
+                  "vmovdqu \\n * 32(%[buf]), %%ymm\\n;"
+                  ".endr"
+                  :: [buf] "r" (buf), "m" (*(const char (*)[AVX_STATE_SIZE])buf));
+}
+
+void __attribute__((target("avx"))) simd_save_avx(void *buf)
+{
+    asm volatile (".irp n, 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15;"
+                  "vmovdqu %%ymm\\n, \\n * 32(%[buf]);"
+                  ".endr"
+                  : "=m" (*(char (*)[AVX_STATE_SIZE])buf)
+                  : [buf] "r" (buf));
+}
+
+/*
+ * The 32 %zmm registers, then %k1-7 at 8 byte strides.  Only the low 16 bits
+ * of each mask register are covered, as wider moves need AVX512BW.  %k0's
+ * slot is unused.
+ */
+void __attribute__((target("avx512f"))) simd_fill_avx512(const void *buf)
+{
+    asm volatile (".irp n, 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,"
+                  "16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31;"
+                  "vmovdqu64 \\n * 64(%[buf]), %%zmm\\n;"
+                  ".endr;"
+                  ".irp n, 1,2,3,4,5,6,7;"
+                  "kmovw 32 * 64 + \\n * 8(%[buf]), %%k\\n;"
+                  ".endr"
+                  :: [buf] "r" (buf),
+                     "m" (*(const char (*)[AVX512_STATE_SIZE])buf)
+                  : "k1", "k2", "k3", "k4", "k5", "k6", "k7");
+}
+
+void __attribute__((target("avx512f"))) simd_save_avx512(void *buf)
+{
+    asm volatile (".irp n, 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,"
+                  "16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31;"
+                  "vmovdqu64 %%zmm\\n, \\n * 64(%[buf]);"
+                  ".endr;"
+                  ".irp n, 1,2,3,4,5,6,7;"
+                  "kmovw %%k\\n, 32 * 64 + \\n * 8(%[buf]);"
+                  ".endr"
+                  : "=m" (*(char (*)[AVX512_STATE_SIZE])buf)
+                  : [buf] "r" (buf));
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,34 @@
+#ifndef PERF_XSAVE_TEST_H
+#define PERF_XSAVE_TEST_H
+
+#include <xtf.h>
+
+/* Bytes of register state each simd_{fill,save}_*() pair covers. */
+#define SSE_STATE_SIZE    (16 * 16)
+#define AVX_STATE_SIZE    (16 * 32)
+#define AVX512_STATE_SIZE (32 * 64 + 8 * 8)
+
+/*
+ * Load every register of the named state from @p buf, leaving the state
+ * in use.  The state must have been enabled with xstate_enable().
+ */
+void simd_fill_sse(const void *buf);
+void simd_fill_avx(const void *buf);
+void simd_fill_avx512(const void *buf);
+
+/* Store every register of the named state to @p buf. */
+void simd_save_sse(void *buf);
+void simd_save_avx(void *buf);
+void simd_save_avx512(void *buf);
+
+#endif /* PERF_XSAVE_TEST_H */
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -37,6 +37,85 @@ static void test_xenstore(void)
     printk("  Found domid %s\n", domid_str);
 }
 
+static void test_xenstore_ops(void)
+{
+    static struct xenstore_req reqs[8];
+    static char bufs[ARRAY_SIZE(reqs)][16];
+    char buf[64];
+    uint32_t tx;
+    int rc;
+
+    printk("Test: Xenstore write/directory/rm/transaction/watch\n");
+
+    rc = xenstore_write(0, "data/xtf", "hello");
+    if ( rc )
+        return xtf_failure("Fail: xenstore_write() returned %d\n", rc);
+
+    /* Pipeline several reads, then collect the replies. */
+    for ( unsigned int i = 0; i < ARRAY_SIZE(reqs); ++i )
+    {
+        xenstore_req_init(&reqs[i], bufs[i], sizeof(bufs[i]));
+        rc = xenstore_submit(&reqs[i], XS_READ, 0, "data/xtf", NULL, 0);
+        if ( rc )
+            return xtf_failure("Fail: xenstore_submit() returned %d\n", rc);
+    }
+
+    for ( unsigned int i = 0; i < ARRAY_SIZE(reqs); ++i )
+    {
+        rc = xenstore_wait(&reqs[i]);
+        if ( rc || strcmp(bufs[i], "hello") )
+            return xtf_failure("Fail: Pipelined read %u: rc %d, '%s'\n",
+                               i, rc, bufs[i]);
+    }
+
+    rc = xenstore_directory(0, "data", buf, sizeof(buf));
+    if ( rc < 0 )
+        return xtf_failure("Fail: xenstore_directory() returned %d\n", rc);
+
+    for ( const char *p = buf; ; p += strlen(p) + 1 )
+    {
+        if ( p >= buf + rc )
+            return xtf_failure("Fail: 'xtf' not found in directory\n");
+
+        if ( !strcmp(p, "xtf") )
+            break;
+    }
+
+    rc = xenstore_transaction_start(&tx);
+    if ( rc )
+        return xtf_failure("Fail: xenstore_transaction_start() returned %d\n",
+                           rc);
+
+    rc = xenstore_write(tx, "data/xtf", "world") ?:
+        xenstore_transaction_end(tx, true);
+    if ( rc )
+        return xtf_failure("Fail: Transaction returned %d\n", rc);
+
+    /* Watches fire once when set. */
+    rc = xenstore_watch("data/xtf", "tok");
+    if ( rc )
+        return xtf_failure("Fail: xenstore_watch() returned %d\n", rc);
+
+    rc = xenstore_wait_watch(buf, sizeof(buf));
+    if ( rc < 0 || strcmp(buf + strlen(buf) + 1, "tok") )
+        return xtf_failure("Fail: Watch event: rc %d\n", rc);
+
+    xenstore_unwatch("data/xtf", "tok");
+
+    rc = xenstore_read_buf(0, "data/xtf", buf, sizeof(buf));
+    if ( rc < 0 || strcmp(buf, "world") )
+        return xtf_failure("Fail: Read after transaction: rc %d\n", rc);
+
+    rc = xenstore_rm(0, "data/xtf");
+    if ( rc )
+        return xtf_failure("Fail: xenstore_rm() returned %d\n", rc);
+
+    rc = xenstore_read_buf(0, "data/xtf", buf, sizeof(buf));
+    if ( rc != -ENOENT )
+        xtf_failure("Fail: Read after rm returned %d, expected %d\n",
+                    rc, -ENOENT);
+}
+
 static void test_extable(void)
 {
     printk("Test: Exception Table\n");
@@ -235,6 +314,249 @@ static void test_driver_init(void)
         xtf_failure("Fail: xtf_init_grant_table(2) returned %d\n", rc);
 }
 
+static unsigned int evtchn_hits;
+
+static void evtchn_hit(evtchn_port_t port, void *data)
+{
+    evtchn_hits++;
+    *(evtchn_port_t *)data = port;
+}
+
+static void test_evtchn(void)
+{
+    evtchn_port_t ipi, unbound, local, seen = 0;
+    int rc;
+
+    printk("Test: Event channel delivery\n");
+
+    rc = evtchn_init();
+    if ( rc )
+        return xtf_failure("Fail: evtchn_init() returned %d\n", rc);
+
+    rc = evtchn_bind_ipi(0, &ipi);
+    if ( rc )
+        return xtf_failure("Fail: evtchn_bind_ipi() returned %d\n", rc);
+
+    evtchn_set_handler(ipi, evtchn_hit, &seen);
+
+    /* Pending while upcalls are disabled, delivered when re-enabled. */
+    evtchn_send(ipi);
+
+    if ( evtchn_hits != 0 )
+        xtf_failure("Fail: IPI delivered with upcalls disabled\n");
+
+    evtchn_enable_upcalls();
+    evtchn_disable_upcalls();
+
+    if ( evtchn_hits != 1 || seen != ipi )
+        xtf_failure("Fail: IPI: %u hits, port %u, expected 1 hit, port %u\n",
+                    evtchn_hits, seen, ipi);
+
+    /* Loopback interdomain channel. */
+    rc = evtchn_alloc_unbound(DOMID_SELF, &unbound);
+    if ( rc )
+        return xtf_failure("Fail: evtchn_alloc_unbound() returned %d\n", rc);
+
+    rc = evtchn_bind_interdomain(DOMID_SELF, unbound, &local);
+    if ( rc )
+        return xtf_failure("Fail: evtchn_bind_interdomain() returned %d\n",
+                           rc);
+
+    evtchn_set_handler(unbound, evtchn_hit, &seen);
+
+    evtchn_send(local);
+    evtchn_enable_upcalls();
+    evtchn_disable_upcalls();
+
+    if ( evtchn_hits != 2 || seen != unbound )
+        xtf_failure("Fail: Interdomain: %u hits, port %u, expected 2 hits, "
+                    "port %u\n", evtchn_hits, seen, unbound);
+
+    evtchn_close(local);
+    evtchn_close(unbound);
+    evtchn_close(ipi);
+}
+
+static unsigned int timer_order[4], timer_fired;
+
+static void timer_hit(struct timer *t, void *data)
+{
+    if ( timer_fired < ARRAY_SIZE(timer_order) )
+        timer_order[timer_fired] = (unsigned long)data;
+
+    if ( ++timer_fired == 4 )
+        timer_cancel(t);
+}
+
+static void timer_cancel_self(struct timer *t, void *data)
+{
+    timer_cancel(t);
+    *(bool *)data = true;
+}
+
+/* Spin, without blocking, until @p cond or @p ns have elapsed. */
+static bool timer_spin(const bool *cond, uint64_t ns)
+{
+    uint64_t end = xen_system_time() + ns;
+
+    while ( !ACCESS_ONCE(*cond) && xen_system_time() < end )
+        barrier();
+
+    return ACCESS_ONCE(*cond);
+}
+
+static void test_timer(void)
+{
+    static struct timer a, b;
+    uint64_t start, now;
+    bool a_fired = false, b_fired = false;
+
+    printk("Test: Timers\n");
+
+    start = xen_system_time();
+    timer_sleep_ns(MILLISECONDS(1));
+    now = xen_system_time();
+
+    if ( now - start < MILLISECONDS(1) )
+        return xtf_failure("Fail: Slept for %"PRIu64"ns, expected 1ms\n",
+                           now - start);
+
+    /*
+     * One-shot at +2ms, and periodic every 2ms from +1ms, which cancels
+     * itself on its third expiry.
+     */
+    evtchn_disable_upcalls();
+    timer_arm_ns(&a, now + MILLISECONDS(2), timer_hit, (void *)1);
+    timer_arm_periodic_ns(&b, now + MILLISECONDS(1), MILLISECONDS(2),
+                          timer_hit, (void *)2);
+
+    timer_sleep_ns(MILLISECONDS(8));
+
+    if ( timer_armed(&a) || timer_armed(&b) || timer_fired != 4 ||
+         timer_order[0] != 2 || timer_order[1] != 1 ||
+         timer_order[2] != 2 || timer_order[3] != 2 )
+        xtf_failure("Fail: Timers fired %u times, order %u %u %u %u, "
+                    "expected 4 times, order 2 1 2 2\n", timer_fired,
+                    timer_order[0], timer_order[1],
+                    timer_order[2], timer_order[3]);
+
+    /*
+     * Timers cancelled from within a handler must leave upcalls usable for
+     * timers armed afterwards, with upcalls enabled throughout.
+     */
+    evtchn_enable_upcalls();
+    timer_arm_periodic_ns(&a, xen_system_time() + MILLISECONDS(1),
+                          MILLISECONDS(1), timer_cancel_self, &a_fired);
+    if ( !timer_spin(&a_fired, MILLISECONDS(10)) )
+        xtf_failure("Fail: Timer didn't fire\n");
+
+    timer_arm_ns(&b, xen_system_time() + MILLISECONDS(1),
+                 timer_cancel_self, &b_fired);
+    if ( !timer_spin(&b_fired, MILLISECONDS(10)) )
+        xtf_failure("Fail: Timer armed after a cancel in a handler didn't "
+                    "fire\n");
+
+    evtchn_disable_upcalls();
+}
+
+static void test_grant_table(void)
+{
+    static uint8_t src[PAGE_SIZE] __page_aligned_bss;
+    static uint8_t dst[PAGE_SIZE] __page_aligned_bss;
+    static grant_ref_t refs[PAGE_SIZE / sizeof(grant_entry_v1_t)];
+    grant_ref_t ref;
+    int rc, domid = xtf_get_domid();
+
+    printk("Test: Grant reference allocation and copy\n");
+
+    if ( domid < 0 )
+        return xtf_failure("Fail: xtf_get_domid() returned %d\n", domid);
+
+    rc = xtf_init_grant_table(1);
+    if ( rc == -ENODEV || rc == -ENOSYS )
+    {
+        printk("  Grant table v1 unavailable: %d\n", rc);
+        return;
+    }
+    if ( rc )
+        return xtf_failure("Fail: xtf_init_grant_table() returned %d\n", rc);
+
+    /* Allocate more references than fit in the first frame. */
+    for ( unsigned int i = 0; i < ARRAY_SIZE(refs); ++i )
+    {
+        rc = gnttab_alloc_ref(&refs[i]);
+        if ( rc )
+            return xtf_failure("Fail: gnttab_alloc_ref() %u returned %d\n",
+                               i, rc);
+
+        if ( refs[i] < GNTTAB_NR_RESERVED_ENTRIES ||
+             (i && refs[i] == refs[i - 1]) )
+            return xtf_failure("Fail: Allocation %u returned ref %u\n",
+                               i, refs[i]);
+    }
+
+    if ( gnttab_nr_frames < 2 )
+        return xtf_failure("Fail: Grant table didn't grow\n");
+
+    for ( unsigned int i = 0; i < ARRAY_SIZE(refs); ++i )
+        gnttab_free_ref(refs[i]);
+
+    strcpy((char *)src, "grant copy");
+
+    rc = gnttab_grant_access(domid, virt_to_gfn(src), true, &ref);
+    if ( rc )
+        return xtf_failure("Fail: gnttab_grant_access() returned %d\n", rc);
+
+    struct gnttab_copy copy = {
+        .source = { .u.ref = ref, .domid = domid },
+        .dest = { .u.gmfn = virt_to_gfn(dst), .domid = domid },
+        .len = sizeof("grant copy"),
+        .flags = GNTCOPY_source_gref,
+    };
+
+    rc = gnttab_batch_copy(&copy, 1);
+    if ( rc || strcmp((char *)dst, "grant copy") )
+        xtf_failure("Fail: Grant copy rc %d, status %d, '%s'\n",
+                    rc, copy.status, dst);
+
+    rc = gnttab_end_access(ref);
+    if ( rc )
+        xtf_failure("Fail: gnttab_end_access() returned %d\n", rc);
+}
+
+static void test_multicall(void)
+{
+    multicall_entry_t ents[2];
+    struct mc_batch mc;
+    long ver, rc;
+
+    printk("Test: Multicall builder\n");
+
+    ver = hypercall_xen_version(XENVER_version, NULL);
+
+    /* XENVER_version returns a positive value, which isn't a failure. */
+    mc_begin(&mc, ents, ARRAY_SIZE(ents));
+    for ( unsigned int i = 0; i < 3; ++i )
+        mc_add_xen_version(&mc, XENVER_version, NULL);
+
+    rc = mc_flush(&mc);
+    if ( rc || mc.issued != 3 || (long)ents[0].result != ver )
+        return xtf_failure("Fail: Batch of xen_version: rc %ld, issued %u, "
+                           "result %ld, expected %ld\n", rc, mc.issued,
+                           (long)ents[0].result, ver);
+
+    /* An unknown subop fails, and is blamed, despite the calls around it. */
+    mc_begin(&mc, ents, ARRAY_SIZE(ents));
+    mc_add_xen_version(&mc, XENVER_version, NULL);
+    mc_add_xen_version(&mc, ~0u, NULL);
+    mc_add_xen_version(&mc, XENVER_version, NULL);
+
+    rc = mc_flush(&mc);
+    if ( rc >= 0 || mc.failed != 1 )
+        xtf_failure("Fail: Expected call 1 to fail, got rc %ld, failed %u\n",
+                    rc, mc.failed);
+}
+
 static void test_vsnprintf_crlf_one(const char *fmt, ...)
 {
     va_list args;
@@ -300,9 +622,18 @@ void test_main(void)
     test_custom_idte();
     test_driver_init();
     test_vsnprintf_crlf();
+    test_evtchn();
+    test_timer();
+    test_multicall();
 
     if ( has_xenstore )
+    {
         test_xenstore();
+        test_xenstore_ops();
+
+        /* Needs xenstore for the domid. */
+        test_grant_table();
+    }
 
     xtf_success(NULL);
 }